@@ -3,13 +3,32 @@
 #include <promise.h>
 
 #include <coroutine>
+#include <cstddef>
 
 namespace evcpp {
 
+// the coroutine frames hold the locals living across the suspension points,
+// so they're larger than the promise states
+using FramePool = SizeClassPool<struct FramePoolTag, 32, 2048>;
+using FramePoolStats = FramePool::Stats;
+
+// the base of the coroutine promise types, the frames are allocated from the
+// free lists of FramePool. the frame is freed with its size, so it goes back
+// to the same size class
+struct FrameAllocated {
+    static void* operator new(std::size_t size) {
+        return FramePool::Allocate(size);
+    }
+
+    static void operator delete(void* ptr, std::size_t size) {
+        FramePool::Deallocate(ptr, size);
+    }
+};
+
 template <typename T, typename E>
 class CoroutineTrait {
    public:
-    class promise_type {
+    class promise_type : public FrameAllocated {
        public:
         promise_type() = default;
         promise_type(promise_type&&) = delete;
@@ -57,7 +76,7 @@ class CoroutineTrait {
 
 template <typename E>
 struct CoroutineTrait<void, E> {
-    class promise_type {
+    class promise_type : public FrameAllocated {
        public:
         promise_type() = default;
         promise_type(promise_type&&) = delete;
@@ -98,6 +117,39 @@ struct CoroutineTrait<void, E> {
     };
 };
 
+// the coroutine awaiting a promise is resumed inline when the promise is
+// settled in the thread of the loop it's suspended in, so a chain of co_await
+// doesn't take a loop iteration per level. the inline resumptions nest, and
+// beyond the limit the resumption is posted to unwind the stack. a promise
+// settled by another thread resumes the coroutine via Dispatch. zero limit
+// posts every resumption, the former behavior
+inline thread_local std::size_t tls_inline_resume_limit = 64;
+inline thread_local std::size_t tls_inline_resume_depth = 0;
+
+inline void SetInlineResumeLimit(std::size_t limit) {
+    tls_inline_resume_limit = limit;
+}
+
+inline void ResumeCoroutine(EventLoop* loop, std::coroutine_handle<> handle) {
+    auto current = EventLoop::Current();
+
+    // no loop to go back to, e.g. the coroutine started out of any loop
+    if (!loop || (current == loop &&
+                  tls_inline_resume_depth < tls_inline_resume_limit)) {
+        ++tls_inline_resume_depth;
+        handle.resume();
+        --tls_inline_resume_depth;
+        return;
+    }
+
+    auto cb = MakeCallback([handle]() mutable { handle.resume(); });
+    if (current == loop) {
+        loop->Post(std::move(cb));
+    } else {
+        loop->Dispatch(std::move(cb));
+    }
+}
+
 template <typename T, typename E>
 class PromiseAwaiter {
    public:
@@ -108,15 +160,17 @@ class PromiseAwaiter {
 
     bool await_ready() noexcept { return promise_.IsPending(); }
 
+    // the continuation runs in the context of the resolver, then it decides
+    // whether to resume inline
     void await_suspend(std::coroutine_handle<> handle) noexcept {
-        auto current = EventLoop::Current();
+        auto loop = EventLoop::Current();
 
         promise_.Then(
-            [this, handle](Result<T, E>&& r) mutable {
+            [this, handle, loop](Result<T, E>&& r) mutable {
                 res_ = std::move(r);
-                handle.resume();
+                ResumeCoroutine(loop, handle);
             },
-            current);
+            nullptr);
     }
 
     auto await_resume() {
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <functional>
+
+namespace evcpp {
+
+template <typename T>
+struct DoubleLinkObject {
+    T* prev;
+    T* next;
+
+    DoubleLinkObject() : prev(Self()), next(Self()) {}
+
+    void Unlink() {
+        if (prev && next) {
+            prev->next = next;
+            next->prev = prev;
+
+            prev = Self();
+            next = Self();
+        }
+    }
+
+    void Link(T* head) {
+        prev = head;
+        next = head->next;
+        head->next->prev = Self();
+        head->next = Self();
+    }
+
+    static bool Iterate(T* head, std::function<bool(T*)>&& cb) {
+        auto node = head->next;
+        while (node != head) {
+            auto next_node = node->next;
+
+            if (!cb(node)) {
+                return false;
+            }
+
+            node = next_node;
+        }
+
+        return true;
+    }
+
+    auto Self() { return static_cast<T*>(this); }
+};
+
+}  // namespace evcpp
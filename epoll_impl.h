@@ -0,0 +1,507 @@
+#pragma once
+
+#include <double_link.h>
+#include <event_loop.h>
+#include <scheduler.h>
+#include <slab_pool.h>
+#include <timing_wheel.h>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <memory>
+#include <vector>
+
+namespace evcpp {
+
+class EventLoopEpollImpl;
+
+class IOEventEpollImpl : public DoubleLinkObject<IOEventEpollImpl>,
+                         public IOEvent,
+                         public PoolAllocated {
+   public:
+    IOEventEpollImpl()
+        : type_(IOEventType::kRead),
+          mode_(IOEventMode::kOneShot),
+          flags_(0),
+          cancelled_(false),
+          fired_(false),
+          ev_(nullptr) {}
+
+    IOEventEpollImpl(EventLoopEpollImpl* ev, Fd fd, IOEventType type,
+                     UniqueFunction<void()>&& cb, IOEventMode mode,
+                     std::uint32_t flags)
+        : fd_(fd),
+          cb_(std::move(cb)),
+          type_(type),
+          mode_(mode),
+          flags_(flags),
+          cancelled_(false),
+          fired_(false),
+          ev_(ev) {
+        Init();
+    }
+
+    void Cancel() override;
+
+    bool Fired() const override { return fired_; }
+    bool Cancelled() const override { return cancelled_; }
+
+    ~IOEventEpollImpl() override { Cancel(); }
+
+   private:
+    void Init();
+
+    bool Match(std::uint32_t revents) const {
+        auto mask = type_ == IOEventType::kRead ? EPOLLIN | EPOLLRDHUP
+                                                : EPOLLOUT;
+        return revents & (mask | EPOLLHUP | EPOLLERR);
+    }
+
+    Fd fd_;
+    UniqueFunction<void()> cb_;
+    IOEventType type_;
+    IOEventMode mode_;
+
+    // EPOLLET and EPOLLEXCLUSIVE
+    std::uint32_t flags_;
+
+    bool cancelled_;
+    bool fired_;
+
+    EventLoopEpollImpl* ev_;
+
+    friend class EventLoopEpollImpl;
+};
+
+struct EventLoopEpollOptions {
+    // the capacity of one epoll_wait, it doubles when it's filled up
+    int max_events = 256;
+
+    // registers all the events added via the EventLoop interface as
+    // edge-triggered, so a ready fd is reported once per change instead of
+    // on every iteration until it's drained
+    bool edge_triggered = false;
+
+    SchedulerOptions scheduler;
+};
+
+// the event loop on top of epoll, without the fd bookkeeping of libev. the
+// events of one fd share one registration, and the changes are applied in a
+// batch before epoll_wait, so adding and cancelling an event within one
+// iteration costs no syscall. the one-shot events are registered with
+// EPOLLONESHOT, then the kernel disarms them without EPOLL_CTL_DEL
+class EventLoopEpollImpl : public EventLoop {
+   public:
+    explicit EventLoopEpollImpl(const EventLoopEpollOptions& options = {})
+        : status_(Status::kInit),
+          epoll_fd_(::epoll_create1(EPOLL_CLOEXEC)),
+          event_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          edge_triggered_(options.edge_triggered),
+          scheduler_(options.scheduler),
+          notified_(false),
+          events_(std::max(options.max_events, 1)),
+          io_pool_(SlabPool::Create(sizeof(IOEventEpollImpl))) {
+        ASSERT(epoll_fd_ >= 0);
+        ASSERT(event_fd_ >= 0);
+
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = event_fd_;
+        auto ret = ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev);
+        ASSERT(ret == 0);
+
+        tls_loop = this;
+    }
+
+    EventLoopEpollImpl(const EventLoopEpollImpl&) = delete;
+    EventLoopEpollImpl& operator=(const EventLoopEpollImpl&) = delete;
+
+    ~EventLoopEpollImpl() override {
+        CancelAllEvents();
+
+        ::close(event_fd_);
+        ::close(epoll_fd_);
+
+        if (tls_loop == this) {
+            tls_loop = nullptr;
+        }
+    }
+
+   public:
+    void Dispatch(UniqueFunction<void()>&& cb,
+                  Priority prio = Priority::kLow) override {
+        scheduler_.Dispatch(std::move(cb), prio);
+
+        // only the first producer since the last drain pays the syscall
+        if (!notified_.exchange(true, std::memory_order_acq_rel)) {
+            std::uint64_t one = 1;
+            auto n = ::write(event_fd_, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    // Post must be invoked in the loop thread, the loop doesn't block while
+    // there are pending tasks
+    void Post(UniqueFunction<void()>&& cb,
+              Priority prio = Priority::kLow) override {
+        scheduler_.Post(std::move(cb), prio);
+    }
+
+    const SchedulerStats& GetSchedulerStats() const {
+        return scheduler_.GetStats();
+    }
+
+    // the event objects are allocated from the pools of the loop
+    const PoolStats& GetTimerPoolStats() const {
+        return timers_.GetPoolStats();
+    }
+
+    const PoolStats& GetIOPoolStats() const { return io_pool_->GetStats(); }
+
+   public:
+    std::unique_ptr<TimerEvent> RunAfter(
+        std::chrono::milliseconds delay,
+        UniqueFunction<void()>&& cb) override {
+        return timers_.Add(delay, std::chrono::milliseconds(0), false,
+                           std::move(cb));
+    }
+
+    std::unique_ptr<TimerEvent> RunEvery(
+        std::chrono::milliseconds interval,
+        UniqueFunction<void()>&& cb) override {
+        return timers_.Add(interval, std::chrono::milliseconds(0), true,
+                           std::move(cb));
+    }
+
+    std::unique_ptr<TimerEvent> RunAfter(
+        std::chrono::milliseconds delay, std::chrono::milliseconds slack,
+        UniqueFunction<void()>&& cb) override {
+        return timers_.Add(delay, slack, false, std::move(cb));
+    }
+
+    std::unique_ptr<TimerEvent> RunEvery(
+        std::chrono::milliseconds interval, std::chrono::milliseconds slack,
+        UniqueFunction<void()>&& cb) override {
+        return timers_.Add(interval, slack, true, std::move(cb));
+    }
+
+   public:
+    std::unique_ptr<IOEvent> AddIOEvent(
+        Fd fd, IOEventType type, UniqueFunction<void()>&& cb,
+        IOEventMode mode = IOEventMode::kOneShot) override {
+        return AddIOEvent(fd, type, std::move(cb), mode,
+                          edge_triggered_ ? EPOLLET : 0);
+    }
+
+    // flags is a combination of EPOLLET and EPOLLEXCLUSIVE. the exclusive
+    // events of the same fd in different loops wake up only one of them,
+    // e.g. a listening socket shared by the loops of a group
+    std::unique_ptr<IOEvent> AddIOEvent(Fd fd, IOEventType type,
+                                        UniqueFunction<void()>&& cb,
+                                        IOEventMode mode,
+                                        std::uint32_t flags) {
+        ASSERT(fd >= 0);
+        ASSERT((flags & ~(EPOLLET | EPOLLEXCLUSIVE)) == 0);
+
+        auto event = new (io_pool_.get())
+            IOEventEpollImpl(this, fd, type, std::move(cb), mode, flags);
+        return std::unique_ptr<IOEvent>(event);
+    }
+
+   public:
+    // the hooks run at the top of the next iteration, before the timeout of
+    // the backend is computed, so the tasks they post don't wait
+    void ScheduleIterationHook(IterationHook* hook) override {
+        hooks_.Schedule(hook);
+    }
+
+   public:
+    void RunForever() override {
+        status_ = Status::kRunning;
+
+        while (status_ == Status::kRunning) {
+            // the end of the last iteration
+            hooks_.Run();
+
+            ApplyChanges();
+
+            int timeout = -1;
+            if (scheduler_.HasPendingTasks()) {
+                timeout = 0;
+            } else if (auto next = timers_.NextTimeout(); next) {
+                timeout = static_cast<int>(next->count());
+            }
+
+            auto n = ::epoll_wait(epoll_fd_, events_.data(),
+                                  static_cast<int>(events_.size()), timeout);
+            for (int i = 0; i < n; ++i) {
+                auto fd = events_[i].data.fd;
+                if (fd == event_fd_) {
+                    std::uint64_t value;
+                    auto r = ::read(event_fd_, &value, sizeof(value));
+                    (void)r;
+                } else {
+                    Ready(fd, events_[i].events);
+                }
+            }
+
+            if (n == static_cast<int>(events_.size())) {
+                events_.resize(events_.size() * 2);
+            }
+
+            timers_.Expire();
+            RunPendingTasks();
+        }
+    }
+
+    void Stop() override {
+        Dispatch(MakeCallback([this]() mutable {
+            status_ = Status::kStopping;
+
+            CancelAllEvents();
+
+            status_ = Status::kStopped;
+        }));
+    }
+
+    Status GetStatus() const override { return status_; }
+
+    std::size_t PendingTaskNum() const override {
+        return scheduler_.PendingTaskNum();
+    }
+
+   private:
+    // the events of one fd, and what is registered in the kernel
+    struct FdState {
+        IOEventEpollImpl head;
+
+        // zero when the kernel disarmed an EPOLLONESHOT registration
+        std::uint32_t armed = 0;
+        bool registered = false;
+        bool dirty = false;
+
+        // all the events were cancelled since the last registration, so the
+        // fd may have been closed and reused, and the kernel may have
+        // dropped the registration with it. the next registration isn't
+        // skipped, which costs an epoll_ctl when the events of a live fd
+        // are dropped and added again within one iteration
+        bool emptied = false;
+    };
+
+    FdState* GetState(Fd fd) {
+        if (static_cast<std::size_t>(fd) >= fds_.size()) {
+            fds_.resize(std::max(fds_.size() * 2, std::size_t(fd) + 1));
+        }
+
+        if (!fds_[fd]) {
+            fds_[fd] = std::make_unique<FdState>();
+        }
+
+        return fds_[fd].get();
+    }
+
+    void MarkDirty(Fd fd) {
+        auto state = GetState(fd);
+        if (!state->dirty) {
+            state->dirty = true;
+            changes_.push_back(fd);
+        }
+    }
+
+    void ApplyChanges() {
+        for (auto fd : changes_) {
+            Apply(fd, fds_[fd].get());
+        }
+
+        changes_.clear();
+    }
+
+    void Apply(Fd fd, FdState* state) {
+        state->dirty = false;
+
+        std::uint32_t want = 0;
+        std::uint32_t flags = 0;
+        bool oneshot = true;
+
+        IOEventEpollImpl::Iterate(&state->head, [&](IOEventEpollImpl* event) {
+            want |= event->type_ == IOEventType::kRead ? EPOLLIN : EPOLLOUT;
+            flags |= event->flags_;
+            oneshot = oneshot && event->mode_ == IOEventMode::kOneShot;
+            return true;
+        });
+
+        if (want == 0) {
+            // a disarmed registration is harmless, and it's gone when the fd
+            // is closed
+            if (state->registered && state->armed != 0) {
+                ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+                state->registered = false;
+            }
+
+            state->armed = 0;
+            state->emptied = false;
+            return;
+        }
+
+        // EPOLLEXCLUSIVE can't be combined with EPOLLONESHOT
+        if (oneshot && !(flags & EPOLLEXCLUSIVE)) {
+            flags |= EPOLLONESHOT;
+        }
+
+        want |= flags;
+        if (state->registered && state->armed == want && !state->emptied) {
+            return;
+        }
+        state->emptied = false;
+
+        epoll_event ev;
+        ev.events = want;
+        ev.data.fd = fd;
+
+        // EPOLLEXCLUSIVE isn't allowed by EPOLL_CTL_MOD. the fd may be closed
+        // and reused since the last registration, so ADD and MOD fall back to
+        // each other
+        if (state->registered && ((want | state->armed) & EPOLLEXCLUSIVE)) {
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            state->registered = false;
+        }
+
+        int ret;
+        if (state->registered) {
+            ret = ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+            if (ret < 0 && errno == ENOENT) {
+                ret = ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+            }
+        } else {
+            ret = ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+            if (ret < 0 && errno == EEXIST) {
+                ret = ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+            }
+        }
+
+        state->registered = ret == 0;
+        state->armed = ret == 0 ? want : 0;
+    }
+
+    // the callback may cancel or add any event, so the ready events are moved
+    // to a local list first, and a cancelled one simply unlinks itself
+    void Ready(Fd fd, std::uint32_t revents) {
+        if (static_cast<std::size_t>(fd) >= fds_.size() || !fds_[fd]) {
+            return;
+        }
+
+        auto state = fds_[fd].get();
+        if (state->armed & EPOLLONESHOT) {
+            state->armed = 0;
+            MarkDirty(fd);
+        }
+
+        IOEventEpollImpl ready;
+        IOEventEpollImpl::Iterate(&state->head,
+                                  [&ready, revents](IOEventEpollImpl* event) {
+                                      if (event->Match(revents)) {
+                                          event->Unlink();
+                                          event->Link(&ready);
+                                      }
+                                      return true;
+                                  });
+
+        while (ready.next != &ready) {
+            auto event = ready.next;
+            event->Unlink();
+            event->fired_ = true;
+
+            if (event->mode_ == IOEventMode::kPersistent) {
+                event->Link(&state->head);
+            } else {
+                // a fired one-shot event is detached, so its handle may
+                // outlive the loop. the fd is treated as emptied, as if the
+                // event were cancelled
+                event->ev_ = nullptr;
+                if (state->head.next == &state->head) {
+                    state->emptied = true;
+                }
+
+                MarkDirty(fd);
+            }
+
+            event->cb_();
+        }
+    }
+
+    void RunPendingTasks() {
+        notified_.exchange(false, std::memory_order_acq_rel);
+        scheduler_.RunOnce();
+    }
+
+    void CancelAllEvents() {
+        for (auto& state : fds_) {
+            if (!state) {
+                continue;
+            }
+
+            IOEventEpollImpl::Iterate(&state->head,
+                                      [](IOEventEpollImpl* event) -> bool {
+                                          event->Cancel();
+                                          return true;
+                                      });
+        }
+
+        timers_.CancelAll();
+    }
+
+    Status status_;
+
+    Fd epoll_fd_;
+    Fd event_fd_;
+    bool edge_triggered_;
+
+    TaskScheduler scheduler_;
+    IterationHookList hooks_;
+    std::atomic<bool> notified_;
+
+    std::vector<epoll_event> events_;
+
+    // indexed by fd
+    std::vector<std::unique_ptr<FdState>> fds_;
+    std::vector<Fd> changes_;
+
+    SlabPool::Ptr io_pool_;
+    WheelTimerService timers_;
+
+    friend class IOEventEpollImpl;
+};
+
+void IOEventEpollImpl::Cancel() {
+    if (cancelled_) {
+        return;
+    }
+
+    // a fired one-shot event is already off the loop
+    if (!ev_) {
+        cancelled_ = true;
+        return;
+    }
+
+    // it may be linked in the fd list, the ready list, or nothing
+    Unlink();
+    ev_->MarkDirty(fd_);
+
+    auto state = ev_->GetState(fd_);
+    if (state->head.next == &state->head) {
+        state->emptied = true;
+    }
+
+    cancelled_ = true;
+}
+
+void IOEventEpollImpl::Init() {
+    Link(&ev_->GetState(fd_)->head);
+    ev_->MarkDirty(fd_);
+}
+
+}  // namespace evcpp
@@ -2,6 +2,23 @@
 
 #include <event_loop.h>
 #include <libev_impl.h>
+#include <event_loop_group.h>
+
+#if __has_include(<sys/epoll.h>)
+#include <epoll_impl.h>
+#endif
+
+#if __has_include(<linux/io_uring.h>)
+#include <io_uring_impl.h>
+#endif
 
 #include <promise.h>
 #include <coroutine.h>
+#include <task.h>
+
+#include <iobuf.h>
+#include <socket.h>
+#include <pipe.h>
+#include <tcp.h>
+#include <udp.h>
+#include <sharded_listener.h>
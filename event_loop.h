@@ -1,11 +1,18 @@
 #pragma once
 
+#include <double_link.h>
+
+#include <algorithm>
 #include <chrono>
+#include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <new>
 #include <optional>
+#include <type_traits>
 #include <variant>
 
 #define ASSERT(expr)                                                     \
@@ -118,36 +125,163 @@ struct IsResult<Result<T, E>> : std::true_type {};
 
 using Callback = std::function<void()>;
 
-template <typename S>
-struct MoveOnlyCallable;
+// the inline capacity of MoveOnlyCallable, e.g. -DEVCPP_CALLABLE_INLINE_SIZE=48.
+// with the pointer to the operations, the default makes a callable 40 bytes,
+// as large as a variant of std::function and a heap pointer
+#ifndef EVCPP_CALLABLE_INLINE_SIZE
+#define EVCPP_CALLABLE_INLINE_SIZE 32
+#endif
 
-template <typename R, typename... Args>
-struct MoveOnlyCallable<R(Args...)> {
-    struct CallableBase {
-        virtual ~CallableBase() = default;
-        virtual R Invoke(Args&&... args) = 0;
+inline constexpr std::size_t kCallableInlineSize = EVCPP_CALLABLE_INLINE_SIZE;
+
+template <typename S, std::size_t N = kCallableInlineSize>
+class MoveOnlyCallable;
+
+// a move-only type-erased callable. the callable is stored inline if it fits
+// in N bytes and is nothrow movable, so the typical capture, e.g. a resolver
+// and a few pointers, costs no allocation. otherwise it's on the heap. the
+// calls go through a static table of operations, one per callable type, and
+// an empty callable points to a table without any operation
+template <typename R, typename... Args, std::size_t N>
+class MoveOnlyCallable<R(Args...), N> {
+   public:
+    MoveOnlyCallable() noexcept : ops_(&kEmptyOps) {}
+
+    template <typename F, typename D = std::decay_t<F>,
+              std::enable_if_t<!std::is_same_v<D, MoveOnlyCallable> &&
+                                   std::is_invocable_r_v<R, D&, Args...>,
+                               int> = 0>
+    MoveOnlyCallable(F&& f) : ops_(&kOps<D>) {
+        if constexpr (kInline<D>) {
+            ::new (static_cast<void*>(storage_)) D(std::forward<F>(f));
+        } else {
+            *reinterpret_cast<D**>(storage_) = new D(std::forward<F>(f));
+        }
+    }
+
+    MoveOnlyCallable(MoveOnlyCallable&& other) noexcept : ops_(other.ops_) {
+        Relocate(other);
+    }
+
+    MoveOnlyCallable& operator=(MoveOnlyCallable&& other) noexcept {
+        if (this != &other) {
+            Reset();
+
+            ops_ = other.ops_;
+            Relocate(other);
+        }
+
+        return *this;
+    }
+
+    MoveOnlyCallable(const MoveOnlyCallable&) = delete;
+    MoveOnlyCallable& operator=(const MoveOnlyCallable&) = delete;
+
+    ~MoveOnlyCallable() {
+        if (ops_->destroy) {
+            ops_->destroy(storage_);
+        }
+    }
+
+   public:
+    R operator()(Args&&... args) {
+        return ops_->invoke(storage_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != &kEmptyOps; }
+
+    // true if the callable is stored inline, it's for the tests and benches
+    bool IsInline() const noexcept { return ops_->is_inline; }
+
+   private:
+    // rounded up to whole words
+    static constexpr std::size_t kStorageSize =
+        (std::max(N, sizeof(void*)) + sizeof(void*) - 1) / sizeof(void*) *
+        sizeof(void*);
+
+    struct Ops {
+        R (*invoke)(void*, Args&&...);
+        // moves the callable from src to the empty dst, and destroys src.
+        // it's null when the storage can be copied as raw bytes
+        void (*move)(void* dst, void* src) noexcept;
+        // it's null when there is nothing to destroy
+        void (*destroy)(void*) noexcept;
+        bool is_inline;
     };
 
-    template <typename F>
-    struct CallableImpl : public CallableBase {
-        F func;
+    template <typename D>
+    static constexpr bool kInline =
+        sizeof(D) <= kStorageSize && alignof(D) <= alignof(void*) &&
+        std::is_nothrow_move_constructible_v<D>;
+
+    // the heap pointer, or a trivially copyable callable, e.g. a lambda
+    // capturing only pointers, is relocated by copying the bytes
+    template <typename D>
+    static constexpr bool kTrivial =
+        !kInline<D> || std::is_trivially_copyable_v<D>;
+
+    template <typename D>
+    static D* Get(void* storage) {
+        if constexpr (kInline<D>) {
+            return std::launder(reinterpret_cast<D*>(storage));
+        } else {
+            return *reinterpret_cast<D**>(storage);
+        }
+    }
 
-        CallableImpl(F&& f) : func(std::move(f)) {}
+    template <typename D>
+    static R Invoke(void* storage, Args&&... args) {
+        return (*Get<D>(storage))(std::forward<Args>(args)...);
+    }
 
-        R Invoke(Args&&... args) override {
-            return func(std::forward<Args>(args)...);
+    template <typename D>
+    static void Move(void* dst, void* src) noexcept {
+        auto from = Get<D>(src);
+        ::new (dst) D(std::move(*from));
+        from->~D();
+    }
+
+    template <typename D>
+    static void Destroy(void* storage) noexcept {
+        if constexpr (kInline<D>) {
+            Get<D>(storage)->~D();
+        } else {
+            delete Get<D>(storage);
         }
+    }
+
+    template <typename D>
+    static constexpr Ops kOps = {
+        &Invoke<D>,
+        kTrivial<D> ? nullptr : &Move<D>,
+        kInline<D> && std::is_trivially_destructible_v<D> ? nullptr
+                                                          : &Destroy<D>,
+        kInline<D>,
     };
 
-    template <typename F>
-    MoveOnlyCallable(F&& f)
-        : cb(new CallableImpl<std::decay_t<F>>(std::forward<F>(f))) {}
+    static constexpr Ops kEmptyOps = {nullptr, nullptr, nullptr, false};
 
-    R operator()(Args&&... args) {
-        return cb->Invoke(std::forward<Args>(args)...);
+    // the source is left empty, so its destructor does nothing
+    void Relocate(MoveOnlyCallable& other) noexcept {
+        if (ops_->move) {
+            ops_->move(storage_, other.storage_);
+        } else {
+            std::memcpy(storage_, other.storage_, kStorageSize);
+        }
+
+        other.ops_ = &kEmptyOps;
     }
 
-    std::unique_ptr<CallableBase> cb;
+    void Reset() noexcept {
+        if (ops_->destroy) {
+            ops_->destroy(storage_);
+        }
+
+        ops_ = &kEmptyOps;
+    }
+
+    const Ops* ops_;
+    alignas(void*) unsigned char storage_[kStorageSize];
 };
 
 using MoveOnlyCallback = MoveOnlyCallable<void()>;
@@ -182,13 +316,10 @@ struct FunctionTraits<R (T::*)(Args...) const> {
 template <typename F>
 struct FunctionTraits : FunctionTraits<decltype(&F::operator())> {};
 
+// the callback type of the whole library, e.g. Executor::Post and the
+// handlers of promises
 template <typename Sig>
-using VariantCallback = std::variant<std::function<Sig>, MoveOnlyCallable<Sig>>;
-
-template <typename Sig, typename... Args>
-void InvokeVariantCallback(VariantCallback<Sig>& cb, Args&&... args) {
-    std::visit([&](auto&& f) mutable { f(std::forward<Args>(args)...); }, cb);
-}
+using UniqueFunction = MoveOnlyCallable<Sig>;
 
 template <typename T>
 std::string TypeToString() {
@@ -203,36 +334,10 @@ std::string TypeToString() {
 
 template <typename F>
 auto MakeCallback(F&& f) {
-    using Decayed = std::decay_t<F>;
-    using Signature = typename FunctionTraits<Decayed>::WrapperSignature;
-
-    constexpr bool can_use_std_function =
-        std::is_copy_constructible_v<Decayed> &&
-        std::is_constructible_v<std::function<Signature>, F&&>;
+    using Signature =
+        typename FunctionTraits<std::decay_t<F>>::WrapperSignature;
 
-    if constexpr (can_use_std_function) {
-        return std::function<Signature>(std::forward<F>(f));
-    } else {
-        return MoveOnlyCallable<Signature>(std::forward<F>(f));
-    }
-}
-
-template <typename Sig, typename Arg0>
-VariantCallback<void()> WrapVariantCallback(VariantCallback<Sig>&& cb,
-                                            Arg0&& arg0) {
-    if (std::holds_alternative<std::function<Sig>>(cb)) {
-        return MakeCallback(
-            [arg0 = std::forward<Arg0>(arg0),
-             cb = std::move(std::get<std::function<Sig>>(cb))]() mutable {
-                cb(std::forward<Arg0>(arg0));
-            });
-    } else {
-        return MakeCallback(
-            [arg0 = std::forward<Arg0>(arg0),
-             cb = std::move(std::get<MoveOnlyCallable<Sig>>(cb))]() mutable {
-                cb(std::forward<Arg0>(arg0));
-            });
-    }
+    return UniqueFunction<Signature>(std::forward<F>(f));
 }
 
 enum class IOEventType {
@@ -240,12 +345,40 @@ enum class IOEventType {
     kWrite,
 };
 
+enum class IOEventMode {
+    // the event is disarmed after the first readiness
+    kOneShot,
+    // the event stays armed and fires on every readiness until cancelled,
+    // so a long-lived connection registers its fd only once
+    kPersistent,
+};
+
 enum class Priority {
     kLow = 0,
     kMedium,
     kHigh,
 };
 
+// the coarse precision classes of timers, see TimerSlack
+enum class TimerPrecision {
+    kPrecise,
+    // e.g. request timeouts
+    kCoarse,
+    // e.g. idle and keepalive timeouts
+    kIdle,
+};
+
+constexpr std::chrono::milliseconds TimerSlack(TimerPrecision precision) {
+    switch (precision) {
+        case TimerPrecision::kCoarse:
+            return std::chrono::milliseconds(50);
+        case TimerPrecision::kIdle:
+            return std::chrono::milliseconds(1000);
+        default:
+            return std::chrono::milliseconds(0);
+    }
+}
+
 using Fd = int;
 
 class TimerEvent {
@@ -270,7 +403,7 @@ class Executor {
    public:
     virtual ~Executor() = default;
 
-    virtual void Post(VariantCallback<void()>&& cb,
+    virtual void Post(UniqueFunction<void()>&& cb,
                       Priority prio = Priority::kLow) = 0;
 };
 
@@ -278,7 +411,7 @@ class RemoteExecutor {
    public:
     virtual ~RemoteExecutor() = default;
 
-    virtual void Dispatch(VariantCallback<void()>&& cb,
+    virtual void Dispatch(UniqueFunction<void()>&& cb,
                           Priority prio = Priority::kLow) = 0;
 };
 
@@ -287,10 +420,91 @@ class TimerProvider {
     virtual ~TimerProvider() = default;
 
     virtual std::unique_ptr<TimerEvent> RunAfter(
-        std::chrono::milliseconds delay, VariantCallback<void()>&& cb) = 0;
+        std::chrono::milliseconds delay, UniqueFunction<void()>&& cb) = 0;
 
     virtual std::unique_ptr<TimerEvent> RunEvery(
-        std::chrono::milliseconds interval, VariantCallback<void()>&& cb) = 0;
+        std::chrono::milliseconds interval, UniqueFunction<void()>&& cb) = 0;
+
+    // the timer may fire up to slack later than requested, so the timers
+    // expiring within the same window are coalesced into one wakeup
+    virtual std::unique_ptr<TimerEvent> RunAfter(
+        std::chrono::milliseconds delay, std::chrono::milliseconds slack,
+        UniqueFunction<void()>&& cb) = 0;
+
+    virtual std::unique_ptr<TimerEvent> RunEvery(
+        std::chrono::milliseconds interval, std::chrono::milliseconds slack,
+        UniqueFunction<void()>&& cb) = 0;
+};
+
+// a callback run once at the end of a loop iteration, after the io events,
+// the timers and the tasks, before the loop blocks in the backend again. the
+// owner embeds the hook and schedules it for every iteration it's needed in,
+// and a destroyed hook is unscheduled, so it never outlives its owner
+class IterationHook : public DoubleLinkObject<IterationHook> {
+   public:
+    IterationHook() = default;
+    explicit IterationHook(UniqueFunction<void()>&& cb) : cb_(std::move(cb)) {}
+
+    IterationHook(const IterationHook&) = delete;
+    IterationHook& operator=(const IterationHook&) = delete;
+
+    ~IterationHook() { Unlink(); }
+
+    bool IsScheduled() const { return next != this; }
+
+    void Run() { cb_(); }
+
+   private:
+    UniqueFunction<void()> cb_;
+};
+
+// the scheduled hooks of a loop, the ones scheduled while running are run in
+// the same round
+class IterationHookList {
+   public:
+    IterationHookList() = default;
+    IterationHookList(const IterationHookList&) = delete;
+    IterationHookList& operator=(const IterationHookList&) = delete;
+
+    // the hooks may outlive the loop
+    ~IterationHookList() {
+        while (!Empty()) {
+            head_.next->Unlink();
+        }
+    }
+
+    bool Empty() const { return head_.next == &head_; }
+
+    // it returns false if the hook is scheduled already
+    bool Schedule(IterationHook* hook) {
+        if (hook->IsScheduled()) {
+            return false;
+        }
+
+        // linked at the tail, the hooks run in the order of scheduling
+        hook->Link(head_.prev);
+        return true;
+    }
+
+    void Run() {
+        while (!Empty()) {
+            auto hook = head_.next;
+            hook->Unlink();
+            hook->Run();
+        }
+    }
+
+   private:
+    IterationHook head_;
+};
+
+class IterationHookProvider {
+   public:
+    virtual ~IterationHookProvider() = default;
+
+    // it must be invoked in the loop thread, the hook runs once and is
+    // scheduled again for the next iteration if needed
+    virtual void ScheduleIterationHook(IterationHook* hook) = 0;
 };
 
 class IOProvider {
@@ -298,7 +512,8 @@ class IOProvider {
     virtual ~IOProvider() = default;
 
     virtual std::unique_ptr<IOEvent> AddIOEvent(
-        Fd fd, IOEventType type, VariantCallback<void()>&& cb) = 0;
+        Fd fd, IOEventType type, UniqueFunction<void()>&& cb,
+        IOEventMode mode = IOEventMode::kOneShot) = 0;
 };
 
 class EventLoop;
@@ -307,7 +522,8 @@ inline thread_local EventLoop* tls_loop;
 class EventLoop : public Executor,
                   public RemoteExecutor,
                   public TimerProvider,
-                  public IOProvider {
+                  public IOProvider,
+                  public IterationHookProvider {
    public:
     enum class Status {
         kInit,
@@ -323,6 +539,10 @@ class EventLoop : public Executor,
 
     virtual Status GetStatus() const = 0;
 
+    // the approximate number of pending tasks, it can be invoked from any
+    // thread
+    virtual std::size_t PendingTaskNum() const = 0;
+
     static EventLoop* Current() { return tls_loop; }
 };
 
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <event_loop.h>
+#include <libev_impl.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace evcpp {
+
+// a group of event loops, each one runs in its own thread. the loops are
+// created inside their threads, so EventLoop::Current() works as usual, and
+// the constructor returns after all of them are created
+class EventLoopGroup {
+   public:
+    using LoopFactory = std::function<std::unique_ptr<EventLoop>()>;
+
+    // num = 0 means one loop per hardware thread
+    explicit EventLoopGroup(std::size_t num = 0, LoopFactory factory = nullptr)
+        : next_(0), stopped_(false) {
+        if (num == 0) {
+            num = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        if (!factory) {
+            factory = []() -> std::unique_ptr<EventLoop> {
+                return std::make_unique<EventLoopLibevImpl>();
+            };
+        }
+
+        loops_.resize(num);
+
+        std::latch ready(num);
+        for (std::size_t i = 0; i < num; ++i) {
+            threads_.emplace_back([this, i, &factory, &ready]() {
+                loops_[i] = factory();
+                auto loop = loops_[i].get();
+                ready.count_down();
+
+                loop->RunForever();
+            });
+        }
+
+        ready.wait();
+    }
+
+    EventLoopGroup(const EventLoopGroup&) = delete;
+    EventLoopGroup& operator=(const EventLoopGroup&) = delete;
+
+    ~EventLoopGroup() {
+        Stop();
+        Join();
+    }
+
+   public:
+    std::size_t Size() const { return loops_.size(); }
+
+    EventLoop* At(std::size_t idx) { return loops_[idx].get(); }
+
+    EventLoop* Next() {
+        auto idx = next_.fetch_add(1, std::memory_order_relaxed);
+        return loops_[idx % loops_.size()].get();
+    }
+
+    // the loop with the least pending tasks, the queue depth is approximate
+    EventLoop* LeastLoaded() {
+        EventLoop* best = nullptr;
+        std::size_t best_num = 0;
+
+        for (auto& loop : loops_) {
+            auto num = loop->PendingTaskNum();
+            if (!best || num < best_num) {
+                best = loop.get();
+                best_num = num;
+            }
+        }
+
+        return best;
+    }
+
+    // the same hash always maps to the same loop, e.g. a connection id
+    EventLoop* ByHash(std::size_t hash) {
+        return loops_[hash % loops_.size()].get();
+    }
+
+    void Stop() {
+        if (stopped_.exchange(true)) {
+            return;
+        }
+
+        for (auto& loop : loops_) {
+            loop->Stop();
+        }
+    }
+
+    // the loops are destroyed with the group, after their threads exit
+    void Join() {
+        for (auto& t : threads_) {
+            if (t.joinable()) {
+                t.join();
+            }
+        }
+    }
+
+   private:
+    std::vector<std::unique_ptr<EventLoop>> loops_;
+    std::vector<std::thread> threads_;
+
+    std::atomic<std::size_t> next_;
+    std::atomic<bool> stopped_;
+};
+
+}  // namespace evcpp
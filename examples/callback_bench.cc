@@ -0,0 +1,132 @@
+#include <evcpp.h>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <variant>
+#include <vector>
+
+// the former callback type, a std::function or a heap allocated move-only
+// callable, invoked through std::visit
+struct LegacyMoveOnly {
+    struct Base {
+        virtual ~Base() = default;
+        virtual void Invoke() = 0;
+    };
+
+    template <typename F>
+    struct Impl : public Base {
+        F func;
+
+        Impl(F&& f) : func(std::move(f)) {}
+
+        void Invoke() override { func(); }
+    };
+
+    template <typename F>
+    LegacyMoveOnly(F&& f) : cb(new Impl<std::decay_t<F>>(std::forward<F>(f))) {}
+
+    void operator()() { cb->Invoke(); }
+
+    std::unique_ptr<Base> cb;
+};
+
+using LegacyCallback = std::variant<std::function<void()>, LegacyMoveOnly>;
+
+template <typename F>
+LegacyCallback MakeLegacyCallback(F&& f) {
+    if constexpr (std::is_copy_constructible_v<std::decay_t<F>>) {
+        return std::function<void()>(std::forward<F>(f));
+    } else {
+        return LegacyMoveOnly(std::forward<F>(f));
+    }
+}
+
+// a callback goes through a queue once, like a posted task: constructed,
+// moved into the queue, moved out, invoked and destroyed. the queue is
+// drained in small batches, so it stays in cache like the task queue of a loop
+template <typename Callback, typename Make, typename Invoke>
+double RunBench(std::size_t num, Make&& make, Invoke&& invoke) {
+    constexpr std::size_t kBatch = 256;
+
+    std::vector<Callback> queue;
+    queue.reserve(kBatch);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < num; i += kBatch) {
+        for (std::size_t j = 0; j < kBatch; ++j) {
+            queue.push_back(make(i + j));
+        }
+
+        for (auto& cb : queue) {
+            auto task = std::move(cb);
+            invoke(task);
+        }
+
+        queue.clear();
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / num;
+}
+
+int main() {
+    constexpr std::size_t kNum = 4 * 1024 * 1024;
+
+    std::uint64_t sum = 0;
+    auto counter = std::make_shared<int>(1);
+
+    auto legacy_invoke = [](LegacyCallback& cb) {
+        std::visit([](auto&& f) { f(); }, cb);
+    };
+    auto unique_invoke = [](evcpp::UniqueFunction<void()>& cb) { cb(); };
+
+    // two pointers, the typical capture of a continuation
+    auto small_legacy = RunBench<LegacyCallback>(
+        kNum,
+        [&sum](std::size_t i) {
+            return MakeLegacyCallback([&sum, i]() { sum += i; });
+        },
+        legacy_invoke);
+    auto small_unique = RunBench<evcpp::UniqueFunction<void()>>(
+        kNum,
+        [&sum](std::size_t i) {
+            return evcpp::MakeCallback([&sum, i]() { sum += i; });
+        },
+        unique_invoke);
+
+    // a move-only capture, e.g. a resolver and an owned buffer
+    auto move_legacy = RunBench<LegacyCallback>(
+        kNum,
+        [&sum, &counter](std::size_t i) {
+            return MakeLegacyCallback(
+                [&sum, c = counter, p = std::make_unique<std::size_t>(i)]() {
+                    sum += *p + *c;
+                });
+        },
+        legacy_invoke);
+    auto move_unique = RunBench<evcpp::UniqueFunction<void()>>(
+        kNum,
+        [&sum, &counter](std::size_t i) {
+            return evcpp::MakeCallback(
+                [&sum, c = counter, p = std::make_unique<std::size_t>(i)]() {
+                    sum += *p + *c;
+                });
+        },
+        unique_invoke);
+
+    std::cout << "sizeof legacy: " << sizeof(LegacyCallback)
+              << ", unique: " << sizeof(evcpp::UniqueFunction<void()>)
+              << std::endl;
+    std::cout << "small capture, legacy: " << small_legacy
+              << " ns/op, unique: " << small_unique << " ns/op" << std::endl;
+    std::cout << "move-only capture, legacy: " << move_legacy
+              << " ns/op, unique: " << move_unique << " ns/op" << std::endl;
+
+    // keeps the callbacks from being optimized out
+    std::cout << "checksum: " << sum << std::endl;
+
+    return 0;
+}
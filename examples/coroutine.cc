@@ -72,17 +72,8 @@ evcpp::Promise<std::vector<int>> TestCase5() {
 }
 
 int main() {
-    evcpp::EventLoop* loop;
-    std::thread t([&loop]() mutable {
-        evcpp::EventLoopLibevImpl el;
-        loop = &el;
-
-        el.RunForever();
-
-        std::cout << "children thread exit..." << std::endl;
-    });
-
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    evcpp::EventLoopGroup group(1);
+    evcpp::EventLoop* loop = group.At(0);
 
     // test 1
     evcpp::Promise<int> p1;
@@ -119,8 +110,10 @@ int main() {
 
     std::cout << "main thread prepare to exit..." << std::endl;
 
-    loop->Stop();
-    t.join();
+    group.Stop();
+    group.Join();
+
+    std::cout << "children thread exit..." << std::endl;
 
     return 0;
 }
@@ -0,0 +1,58 @@
+#include <evcpp.h>
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// measures the throughput of RemoteExecutor::Dispatch when many producer
+// threads submit tasks to one event loop at the same time
+double RunBench(evcpp::EventLoop* loop, int producers, std::size_t total) {
+    std::size_t per_producer = total / producers;
+    std::uint64_t executed = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back([loop, per_producer, &executed]() {
+            for (std::size_t j = 0; j < per_producer; ++j) {
+                loop->Dispatch(
+                    evcpp::MakeCallback([&executed]() { ++executed; }));
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // the queue is FIFO within one priority, so the fence task runs last
+    std::promise<void> done;
+    loop->Dispatch(evcpp::MakeCallback([&done]() { done.set_value(); }));
+    done.get_future().wait();
+
+    auto elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+    ASSERT(executed == per_producer * producers);
+
+    return executed / elapsed;
+}
+
+int main() {
+    evcpp::EventLoopGroup group(1);
+    evcpp::EventLoop* loop = group.At(0);
+
+    constexpr std::size_t kTotalTasks = 4 * 1024 * 1024;
+
+    for (int producers : {1, 4, 16, 64}) {
+        auto ops = RunBench(loop, producers, kTotalTasks);
+        std::cout << "producers: " << producers
+                  << ", throughput: " << ops / 1e6 << " Mops/s" << std::endl;
+    }
+
+    return 0;
+}
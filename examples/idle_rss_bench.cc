@@ -0,0 +1,177 @@
+#include <evcpp.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// every client sends one request, waits for the echo and then stays idle,
+// so the server ends up with all its connections waiting for data. a
+// connection with its own buffer keeps it while idle, a pooled one borrows
+// a block only when data arrives, e.g.
+//   idle_rss_bench 100000
+// needs 2 fds per connection, the count is cut to the fd limit
+constexpr std::size_t kRequestSize = 128;
+
+std::size_t ResidentBytes() {
+    std::size_t pages = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+std::atomic<std::size_t> served{0};
+
+evcpp::Promise<void> ServeOwned(evcpp::TcpStream stream) {
+    std::vector<char> buf(evcpp::IOBuf::kBlockSize);
+
+    while (true) {
+        auto r = co_await stream.Read(buf.data(), buf.size());
+        if (r.IsError() || r.Value() == 0) {
+            break;
+        }
+        auto w = co_await stream.Write(buf.data(), r.Value());
+        if (w.IsError()) {
+            break;
+        }
+        ++served;
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+evcpp::Promise<void> ServePooled(evcpp::TcpStream stream) {
+    while (true) {
+        evcpp::IOBuf in;
+        auto r = co_await stream.Read(in);
+        if (r.IsError() || r.Value() == 0) {
+            break;
+        }
+        auto w = co_await stream.Write(std::move(in));
+        if (w.IsError()) {
+            break;
+        }
+        ++served;
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+evcpp::Promise<void> AcceptAll(evcpp::TcpListener* listener, bool pooled) {
+    while (true) {
+        auto r = co_await listener->Accept();
+        if (!r) {
+            break;
+        }
+        if (pooled) {
+            ServePooled(std::move(r.Value()));
+        } else {
+            ServeOwned(std::move(r.Value()));
+        }
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+// the ephemeral ports of one destination run out at some 28k connections,
+// so the clients are spread over the loopback addresses
+bool RunClients(std::uint16_t port, std::size_t connections,
+                std::vector<int>* fds) {
+    char request[kRequestSize] = {};
+    char response[kRequestSize];
+
+    for (std::size_t i = 0; i < connections; ++i) {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK + i / 16384);
+
+        auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 ||
+            ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) <
+                0 ||
+            ::send(fd, request, sizeof(request), MSG_NOSIGNAL) !=
+                ssize_t(sizeof(request)) ||
+            ::recv(fd, response, sizeof(response), MSG_WAITALL) !=
+                ssize_t(sizeof(response))) {
+            std::cerr << "client #" << i << ": " << std::strerror(errno)
+                      << std::endl;
+            return false;
+        }
+        fds->push_back(fd);
+    }
+
+    return true;
+}
+
+// the loop belongs to the server thread, the clients block in the main one
+void RunMode(std::size_t connections, bool pooled) {
+    std::atomic<std::uint16_t> port{0};
+
+    std::thread server([&]() {
+        auto loop = std::make_unique<evcpp::EventLoopEpollImpl>();
+        auto listener = std::move(
+            evcpp::TcpListener::Listen(loop.get(), evcpp::InetAddress::Any(0))
+                .Value());
+        port = listener.LocalAddress().Value().Port();
+
+        AcceptAll(&listener, pooled);
+        loop->RunForever();
+    });
+
+    while (port == 0) {
+        std::this_thread::yield();
+    }
+
+    auto before = ResidentBytes();
+
+    std::vector<int> fds;
+    fds.reserve(connections);
+    auto ok = RunClients(port, connections, &fds);
+    while (ok && served < connections) {
+        std::this_thread::yield();
+    }
+
+    auto growth = ResidentBytes() - before;
+    std::cout << (pooled ? "pooled buffers: " : "own buffers:    ")
+              << fds.size() << " idle connections, rss +" << growth / 1024
+              << " KiB, " << growth / std::max<std::size_t>(fds.size(), 1)
+              << " bytes/conn" << std::endl;
+
+    // the suspended connections are left to the exit
+    std::_Exit(ok ? 0 : 1);
+}
+
+int main(int argc, char** argv) {
+    std::size_t connections = argc > 1 ? std::stoul(argv[1]) : 10000;
+
+    rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, connections * 2 + 64);
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    if (connections * 2 + 64 > limit.rlim_cur) {
+        connections = (limit.rlim_cur - 64) / 2;
+        std::cout << "fd limit " << limit.rlim_cur << ", running "
+                  << connections << " connections" << std::endl;
+    }
+
+    // every mode runs in its own process, so the memory of one doesn't
+    // linger in the heap of the other
+    for (auto pooled : {false, true}) {
+        auto pid = ::fork();
+        if (pid == 0) {
+            RunMode(connections, pooled);
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <evcpp.h>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+
+evcpp::Promise<void> PingPong(evcpp::EventLoopUringImpl* el, int fd0, int fd1) {
+    char buf[64];
+
+    for (int i = 0; i < 3; ++i) {
+        std::string msg = "ping " + std::to_string(i);
+
+        auto written = co_await el->Write(fd0, msg.data(), msg.size());
+        if (written.IsError()) {
+            std::cout << "write error: " << written.Error().message()
+                      << std::endl;
+            co_return evcpp::Result<void>();
+        }
+
+        auto nread = co_await el->Read(fd1, buf, sizeof(buf));
+        if (nread.IsError()) {
+            std::cout << "read error: " << nread.Error().message()
+                      << std::endl;
+            co_return evcpp::Result<void>();
+        }
+
+        std::cout << "received: " << std::string(buf, nread.Value())
+                  << std::endl;
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+int main() {
+    if (!evcpp::EventLoopUringImpl::IsSupported()) {
+        std::cout << "io_uring is not supported, skipped" << std::endl;
+        return 0;
+    }
+
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        return 1;
+    }
+
+    evcpp::EventLoopGroup group(1, []() -> std::unique_ptr<evcpp::EventLoop> {
+        return std::make_unique<evcpp::EventLoopUringImpl>();
+    });
+    auto loop = static_cast<evcpp::EventLoopUringImpl*>(group.At(0));
+
+    // the ping pong and then one timeout, the main thread waits for both
+    std::promise<void> done;
+    evcpp::Promise<void> ping_pong;
+    std::unique_ptr<evcpp::TimerEvent> timer;
+
+    loop->Dispatch(evcpp::MakeCallback([&]() {
+        ping_pong = PingPong(loop, fds[0], fds[1]);
+        ping_pong.Then([&](evcpp::Result<void>&&) {
+            std::cout << "ping pong done" << std::endl;
+
+            timer = loop->RunAfter(
+                std::chrono::milliseconds(200), evcpp::MakeCallback([&]() {
+                    std::cout << "200 ms timeout" << std::endl;
+                    done.set_value();
+                }));
+        });
+    }));
+    done.get_future().wait();
+
+    std::promise<void> dispatched;
+    loop->Dispatch(evcpp::MakeCallback([&]() {
+        std::cout << "dispatch task" << std::endl;
+        dispatched.set_value();
+    }));
+    dispatched.get_future().wait();
+
+    group.Stop();
+    group.Join();
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+
+    return 0;
+}
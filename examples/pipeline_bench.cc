@@ -0,0 +1,125 @@
+#include <evcpp.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+// the requests and the responses are fixed-size messages, a client sends a
+// batch of pipelined requests at once and waits for all the responses
+constexpr std::size_t kMessageSize = 16;
+constexpr std::size_t kPipeline = 32;
+constexpr std::size_t kBatches = 20000;
+
+// every response is written as soon as its request is parsed, one syscall
+// per response, or queued and written once at the end of the iteration
+evcpp::Promise<void> Serve(evcpp::TcpStream stream, bool cork) {
+    evcpp::IOBuf in;
+
+    while (true) {
+        auto r = co_await stream.Read(in);
+        if (r.IsError() || r.Value() == 0) {
+            break;
+        }
+
+        while (in.Size() >= kMessageSize) {
+            auto request = in.Split(kMessageSize);
+
+            if (cork) {
+                stream.Queue(std::move(request));
+            } else {
+                auto w = co_await stream.Write(std::move(request));
+                if (w.IsError()) {
+                    co_return evcpp::Result<void>();
+                }
+            }
+        }
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+evcpp::Promise<void> Accept(evcpp::TcpListener* listener, bool cork) {
+    auto r = co_await listener->Accept();
+    if (r) {
+        r.Value().SetNoDelay(true);
+        Serve(std::move(r.Value()), cork);
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+evcpp::Promise<double> RunClient(evcpp::EventLoop* loop,
+                                 evcpp::InetAddress addr) {
+    auto c = co_await evcpp::TcpStream::Connect(loop, addr);
+    if (!c) {
+        co_return std::move(c.Error());
+    }
+
+    auto stream = std::move(c.Value());
+    stream.SetNoDelay(true);
+
+    char batch[kMessageSize * kPipeline];
+    std::memset(batch, 'x', sizeof(batch));
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t i = 0; i < kBatches; ++i) {
+        auto w = co_await stream.Write(batch, sizeof(batch));
+        if (w.IsError()) {
+            co_return std::move(w.Error());
+        }
+
+        evcpp::IOBuf in;
+        while (in.Size() < sizeof(batch)) {
+            auto r = co_await stream.Read(in);
+            if (r.IsError() || r.Value() == 0) {
+                co_return std::make_error_code(std::errc::connection_reset);
+            }
+        }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    co_return std::chrono::duration<double, std::nano>(elapsed).count() /
+        (kBatches * kPipeline);
+}
+
+int main() {
+    auto loop = std::make_unique<evcpp::EventLoopLibevImpl>();
+
+    auto cork_listener = std::move(
+        evcpp::TcpListener::Listen(loop.get(), evcpp::InetAddress::Loopback(0))
+            .Value());
+    auto direct_listener = std::move(
+        evcpp::TcpListener::Listen(loop.get(), evcpp::InetAddress::Loopback(0))
+            .Value());
+
+    auto cork_addr = cork_listener.LocalAddress().Value();
+    auto direct_addr = direct_listener.LocalAddress().Value();
+
+    loop->Dispatch(evcpp::MakeCallback([&]() {
+        Accept(&direct_listener, false);
+        Accept(&cork_listener, true);
+
+        RunClient(loop.get(), direct_addr)
+            .Then(
+                [&](evcpp::Result<double>&& direct) {
+                    RunClient(loop.get(), cork_addr)
+                        .Then(
+                            [&, direct_ns = direct.Value()](
+                                evcpp::Result<double>&& cork) {
+                                std::cout << "pipeline of " << kPipeline
+                                          << ", direct writes: " << direct_ns
+                                          << " ns/req, queued writes: "
+                                          << cork.Value() << " ns/req"
+                                          << std::endl;
+                                loop->Stop();
+                            },
+                            nullptr);
+                },
+                nullptr);
+    }));
+
+    loop->RunForever();
+
+    return 0;
+}
@@ -5,17 +5,8 @@
 #include <thread>
 
 int main() {
-    evcpp::EventLoop* loop;
-    std::thread t([&loop]() mutable {
-        evcpp::EventLoopLibevImpl el;
-        loop = &el;
-
-        el.RunForever();
-
-        std::cout << "children thread exit..." << std::endl;
-    });
-
-    std::this_thread::sleep_for(std::chrono::seconds(1));
+    evcpp::EventLoopGroup group(1);
+    evcpp::EventLoop* loop = group.At(0);
 
     // case 1
     evcpp::Promise<int> p1(loop);
@@ -270,8 +261,10 @@ int main() {
 
     std::cout << "main thread prepare to exit..." << std::endl;
 
-    loop->Stop();
-    t.join();
+    group.Stop();
+    group.Join();
+
+    std::cout << "children thread exit..." << std::endl;
 
     return 0;
 }
@@ -0,0 +1,87 @@
+#include <evcpp.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// the clients connect, wait until the server closes the connection and
+// reset their side, so no port lingers in TIME_WAIT. the server closes
+// every stream as soon as it's accepted
+constexpr std::size_t kConnections = 20000;
+constexpr std::size_t kClientThreads = 4;
+
+std::atomic<std::size_t> handled{0};
+
+void RunClients(std::uint16_t port) {
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < kClientThreads; ++t) {
+        threads.emplace_back([port]() {
+            sockaddr_in addr = {};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            for (std::size_t i = 0; i < kConnections / kClientThreads; ++i) {
+                auto fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (::connect(fd, reinterpret_cast<sockaddr*>(&addr),
+                              sizeof(addr)) == 0) {
+                    char c;
+                    (void)::recv(fd, &c, 1, 0);
+                }
+
+                linger reset = {1, 0};
+                ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+                ::close(fd);
+            }
+        });
+    }
+
+    for (auto& t : threads) {
+        t.join();
+    }
+}
+
+void Run(const std::string& name, std::size_t loops,
+         const evcpp::ShardedTcpListenerOptions& options) {
+    evcpp::EventLoopGroup group(loops, []() {
+        return std::unique_ptr<evcpp::EventLoop>(
+            std::make_unique<evcpp::EventLoopEpollImpl>());
+    });
+
+    handled = 0;
+    auto listener = std::move(
+        evcpp::ShardedTcpListener::Listen(
+            &group, evcpp::InetAddress::Loopback(0),
+            [](evcpp::TcpStream) { ++handled; }, options)
+            .Value());
+
+    auto start = std::chrono::steady_clock::now();
+    RunClients(listener.LocalAddress().Port());
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    auto seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << name << ": " << handled / seconds << " conn/s, per loop";
+    for (auto n : listener.AcceptedPerLoop()) {
+        std::cout << " " << n;
+    }
+    std::cout << std::endl;
+}
+
+int main() {
+    evcpp::ShardedTcpListenerOptions options;
+    Run("1 loop           ", 1, options);
+    Run("4 loops, hash    ", 4, options);
+
+    options.steering = evcpp::AcceptSteering::kCpu;
+    options.pin_loops = true;
+    Run("4 loops, cpu bpf ", 4, options);
+
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <evcpp.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+evcpp::Task<int> Add(int a, int b) { co_return a + b; }
+
+evcpp::Task<int> Fail() {
+    co_return std::make_error_code(std::errc::invalid_argument);
+}
+
+evcpp::Task<void> Nothing() { co_return evcpp::Result<void>(); }
+
+// a task may await a promise, e.g. an io operation or a timer
+evcpp::Task<std::string> Sleep(std::chrono::milliseconds delay) {
+    auto ev = evcpp::EventLoop::Current();
+    evcpp::Promise<int> promise(ev);
+
+    auto timer_event = ev->RunAfter(
+        delay,
+        evcpp::MakeCallback([resolver = promise.GetResolver()]() mutable {
+            resolver.Resolve(int(0));
+        }));
+
+    co_await promise;
+    co_return std::string("slept");
+}
+
+// the same call chain, built of promises and of tasks
+evcpp::Promise<int> PromiseChain(int depth) {
+    if (depth == 0) {
+        co_return 0;
+    }
+
+    auto r = co_await PromiseChain(depth - 1);
+    co_return r.Value() + 1;
+}
+
+evcpp::Task<int> TaskChain(int depth) {
+    if (depth == 0) {
+        co_return 0;
+    }
+
+    auto r = co_await TaskChain(depth - 1);
+    co_return r.Value() + 1;
+}
+
+evcpp::Task<void> Cases() {
+    auto sum = co_await Add(1, 2);
+    std::cout << "add: " << sum.Value() << std::endl;
+
+    auto err = co_await Fail();
+    std::cout << "fail: " << err.Error().message() << std::endl;
+
+    auto nothing = co_await Nothing();
+    std::cout << "nothing, error: " << nothing.IsError() << std::endl;
+
+    auto slept = co_await Sleep(std::chrono::milliseconds(10));
+    std::cout << "sleep: " << slept.Value() << std::endl;
+
+    co_return evcpp::Result<void>();
+}
+
+template <typename F>
+double Measure(int rounds, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        f();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / rounds;
+}
+
+int main() {
+    constexpr int kDepth = 32;
+    constexpr int kRounds = 100000;
+
+    auto loop = evcpp::MakeEventLoop();
+
+    loop->Dispatch(evcpp::MakeCallback([&loop]() {
+        // a task is started by co_await, or by ToPromise
+        auto promise = Cases().ToPromise();
+
+        promise.Then(
+            [&loop](evcpp::Result<void>&& r) {
+                std::cout << "cases done" << std::endl;
+
+                // both chains complete synchronously, IsPending means
+                // settled without a callback attached
+                auto promise_ns = Measure(kRounds, []() {
+                    auto p = PromiseChain(kDepth);
+                    ASSERT(p.IsPending());
+                });
+                auto task_ns = Measure(kRounds, []() {
+                    auto p = TaskChain(kDepth).ToPromise();
+                    ASSERT(p.IsPending());
+                });
+
+                std::cout << "chain of " << kDepth
+                          << ", promise: " << promise_ns
+                          << " ns, task: " << task_ns << " ns" << std::endl;
+
+                // the frames are recycled by the per-thread free lists
+                auto stats = evcpp::FramePool::GetStats();
+                std::cout << "frames, hits: " << stats.hits
+                          << ", misses: " << stats.misses
+                          << ", largest: " << stats.largest << " bytes"
+                          << std::endl;
+
+                loop->Stop();
+            },
+            nullptr);
+    }));
+
+    loop->RunForever();
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <evcpp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+// compares the cost of arming and cancelling many outstanding timers, e.g.
+// per-request timeouts which are almost always cancelled before they fire
+void RunBench(evcpp::TimerBackend backend, std::size_t num) {
+    evcpp::EventLoopLibevOptions options;
+    options.timer_backend = backend;
+
+    evcpp::EventLoopLibevImpl el(options);
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> delay(1000, 60000);
+
+    std::vector<std::unique_ptr<evcpp::TimerEvent>> timers;
+    timers.reserve(num);
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < num; ++i) {
+        timers.push_back(el.RunAfter(std::chrono::milliseconds(delay(rng)),
+                                     evcpp::MakeCallback([]() {})));
+    }
+    auto armed = std::chrono::steady_clock::now();
+
+    // cancels in a random order
+    std::shuffle(timers.begin(), timers.end(), rng);
+    for (auto& timer : timers) {
+        timer->Cancel();
+    }
+    auto cancelled = std::chrono::steady_clock::now();
+
+    auto ns = [num](auto d) {
+        return std::chrono::duration<double, std::nano>(d).count() / num;
+    };
+
+    std::cout << (backend == evcpp::TimerBackend::kHeap ? "heap " : "wheel")
+              << " timers: " << num << ", insert: " << ns(armed - start)
+              << " ns/op, cancel: " << ns(cancelled - armed)
+              << " ns/op, slabs: " << el.GetTimerPoolStats().slabs << std::endl;
+}
+
+int main() {
+    for (std::size_t num : {10000, 100000, 1000000}) {
+        RunBench(evcpp::TimerBackend::kHeap, num);
+        RunBench(evcpp::TimerBackend::kWheel, num);
+    }
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <evcpp.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// the sender sends a batch of datagrams over loopback and the receiver takes
+// all of them before the next batch, so none is dropped. a batch of one is
+// a syscall per datagram on either side, a gso batch is one train split by
+// the kernel, and a gro receiver gets the train coalesced again
+constexpr std::size_t kDatagrams = 500000;
+
+struct Mode {
+    const char* name;
+    std::size_t batch;
+    // the ring slots of the receiver, 64k each with gro
+    std::size_t receive_batch;
+    std::size_t datagram_size;
+    bool gso;
+    bool gro;
+};
+
+evcpp::Promise<double> Run(evcpp::EventLoop* loop, Mode mode) {
+    evcpp::UdpSocketOptions rx_options;
+    rx_options.batch = mode.receive_batch;
+    rx_options.gro = mode.gro;
+    rx_options.receive_buffer = 4 * 1024 * 1024;
+
+    evcpp::UdpSocketOptions tx_options;
+    tx_options.batch = mode.batch;
+
+    auto rx = std::move(evcpp::UdpSocket::Bind(
+                            loop, evcpp::InetAddress::Loopback(0), rx_options)
+                            .Value());
+    auto tx = std::move(
+        evcpp::UdpSocket::Open(loop, AF_INET, tx_options).Value());
+    tx.Connect(rx.LocalAddress().Value());
+
+    std::vector<char> payload(mode.batch * mode.datagram_size, 'x');
+    std::vector<evcpp::Datagram> datagrams;
+    if (mode.gso) {
+        evcpp::Datagram train;
+        train.data = payload.data();
+        train.size = payload.size();
+        train.segment_size = mode.datagram_size;
+        datagrams.push_back(train);
+    } else {
+        for (std::size_t i = 0; i < mode.batch; ++i) {
+            evcpp::Datagram datagram;
+            datagram.data = payload.data() + i * mode.datagram_size;
+            datagram.size = mode.datagram_size;
+            datagrams.push_back(datagram);
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (std::size_t sent = 0; sent < kDatagrams; sent += mode.batch) {
+        auto s = co_await tx.Send(datagrams);
+        if (s.IsError()) {
+            co_return std::move(s.Error());
+        }
+
+        for (std::size_t received = 0; received < mode.batch;) {
+            auto r = co_await rx.Receive();
+            if (r.IsError()) {
+                co_return std::move(r.Error());
+            }
+            for (auto& datagram : r.Value()) {
+                received += datagram.Segments();
+            }
+        }
+    }
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    co_return std::chrono::duration<double, std::nano>(elapsed).count() /
+        kDatagrams;
+}
+
+evcpp::Promise<void> RunAll(evcpp::EventLoop* loop) {
+    // 44 datagrams of 1472 bytes fit in one train of 64k, which a gro
+    // receiver takes in a single slot
+    const Mode modes[] = {
+        {"64 bytes, batch 1        ", 1, 1, 64, false, false},
+        {"64 bytes, batch 8        ", 8, 8, 64, false, false},
+        {"64 bytes, batch 64       ", 64, 64, 64, false, false},
+        {"1472 bytes, batch 44     ", 44, 44, 1472, false, false},
+        {"1472 bytes, gso 44       ", 44, 44, 1472, true, false},
+        {"1472 bytes, gso 44 + gro ", 44, 4, 1472, true, true},
+    };
+
+    for (auto& mode : modes) {
+        auto r = co_await Run(loop, mode);
+        if (r.IsError()) {
+            std::cerr << mode.name << ": " << r.Error().message()
+                      << std::endl;
+            continue;
+        }
+        std::cout << mode.name << ": " << r.Value() << " ns/datagram, "
+                  << mode.datagram_size * 1e3 / r.Value() << " MB/s"
+                  << std::endl;
+    }
+
+    loop->Stop();
+    co_return evcpp::Result<void>();
+}
+
+int main() {
+    auto loop = std::make_unique<evcpp::EventLoopEpollImpl>();
+    RunAll(loop.get());
+    loop->RunForever();
+    return 0;
+}
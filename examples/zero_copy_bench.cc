@@ -0,0 +1,187 @@
+#include <evcpp.h>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// a file served with sendfile or with pread and write, and a stream proxied
+// with splice or with read and write, the client only counts the bytes
+constexpr std::size_t kFileSize = 64 * 1024 * 1024;
+constexpr std::size_t kStreamSize = 256 * 1024 * 1024;
+constexpr std::size_t kChunkSize = 64 * 1024;
+
+evcpp::Promise<std::size_t> Drain(evcpp::EventLoop* loop,
+                                  evcpp::InetAddress addr) {
+    auto c = co_await evcpp::TcpStream::Connect(loop, addr);
+    if (!c) {
+        co_return std::move(c.Error());
+    }
+
+    auto stream = std::move(c.Value());
+    std::vector<char> buf(kChunkSize);
+    std::size_t total = 0;
+
+    while (true) {
+        auto r = co_await stream.Read(buf.data(), buf.size());
+        if (r.IsError()) {
+            co_return std::move(r.Error());
+        }
+        if (r.Value() == 0) {
+            break;
+        }
+        total += r.Value();
+    }
+
+    co_return std::size_t(total);
+}
+
+evcpp::Promise<void> ServeFile(evcpp::TcpListener* listener, int file,
+                               bool zero_copy) {
+    auto r = co_await listener->Accept();
+    if (!r) {
+        co_return evcpp::Result<void>();
+    }
+    auto stream = std::move(r.Value());
+
+    if (zero_copy) {
+        co_await stream.SendFile(file, 0, kFileSize);
+        co_return evcpp::Result<void>();
+    }
+
+    std::vector<char> buf(kChunkSize);
+    for (off_t offset = 0; offset < off_t(kFileSize);) {
+        auto n = ::pread(file, buf.data(), buf.size(), offset);
+        if (n <= 0) {
+            break;
+        }
+        auto w = co_await stream.Write(buf.data(), n);
+        if (w.IsError()) {
+            break;
+        }
+        offset += n;
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+evcpp::Promise<void> ServeStream(evcpp::TcpListener* listener) {
+    auto r = co_await listener->Accept();
+    if (!r) {
+        co_return evcpp::Result<void>();
+    }
+    auto stream = std::move(r.Value());
+
+    std::vector<char> buf(kChunkSize, 'x');
+    for (std::size_t sent = 0; sent < kStreamSize; sent += buf.size()) {
+        auto w = co_await stream.Write(buf.data(), buf.size());
+        if (w.IsError()) {
+            break;
+        }
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+evcpp::Promise<void> Proxy(evcpp::TcpListener* listener,
+                           evcpp::InetAddress upstream, bool zero_copy) {
+    auto r = co_await listener->Accept();
+    if (!r) {
+        co_return evcpp::Result<void>();
+    }
+    auto client = std::move(r.Value());
+
+    auto c = co_await evcpp::TcpStream::Connect(listener->GetLoop(), upstream);
+    if (!c) {
+        co_return evcpp::Result<void>();
+    }
+    auto server = std::move(c.Value());
+
+    if (zero_copy) {
+        auto pipe = std::move(evcpp::Pipe::Create().Value());
+        pipe.SetCapacity(1024 * 1024);
+        co_await evcpp::Splice(server, client, pipe);
+        co_return evcpp::Result<void>();
+    }
+
+    while (true) {
+        evcpp::IOBuf in;
+        auto n = co_await server.Read(in, kChunkSize);
+        if (n.IsError() || n.Value() == 0) {
+            break;
+        }
+        auto w = co_await client.Write(std::move(in));
+        if (w.IsError()) {
+            break;
+        }
+    }
+
+    co_return evcpp::Result<void>();
+}
+
+evcpp::TcpListener Listen(evcpp::EventLoop* loop) {
+    return std::move(
+        evcpp::TcpListener::Listen(loop, evcpp::InetAddress::Loopback(0))
+            .Value());
+}
+
+void Report(const char* name, std::size_t bytes,
+            std::chrono::steady_clock::duration elapsed) {
+    auto seconds = std::chrono::duration<double>(elapsed).count();
+    std::cout << name << ": " << bytes / (1024 * 1024) << " MiB, "
+              << bytes / (1024 * 1024) / seconds << " MiB/s" << std::endl;
+}
+
+evcpp::Promise<void> RunAll(evcpp::EventLoop* loop, int file) {
+    for (auto zero_copy : {false, true}) {
+        auto listener = Listen(loop);
+        ServeFile(&listener, file, zero_copy);
+
+        auto start = std::chrono::steady_clock::now();
+        auto n = co_await Drain(loop, listener.LocalAddress().Value());
+        Report(zero_copy ? "sendfile        " : "pread and write ",
+               n.Value(), std::chrono::steady_clock::now() - start);
+    }
+
+    for (auto zero_copy : {false, true}) {
+        auto source = Listen(loop);
+        auto proxy = Listen(loop);
+        ServeStream(&source);
+        Proxy(&proxy, source.LocalAddress().Value(), zero_copy);
+
+        auto start = std::chrono::steady_clock::now();
+        auto n = co_await Drain(loop, proxy.LocalAddress().Value());
+        Report(zero_copy ? "splice proxy    " : "read-write proxy",
+               n.Value(), std::chrono::steady_clock::now() - start);
+    }
+
+    loop->Stop();
+    co_return evcpp::Result<void>();
+}
+
+int main() {
+    char path[] = "/tmp/evcpp_zero_copy_XXXXXX";
+    auto file = ::mkstemp(path);
+    if (file < 0) {
+        std::cerr << "mkstemp failed" << std::endl;
+        return 1;
+    }
+    ::unlink(path);
+
+    std::vector<char> chunk(kChunkSize, 'y');
+    for (std::size_t size = 0; size < kFileSize; size += chunk.size()) {
+        if (::write(file, chunk.data(), chunk.size()) < 0) {
+            std::cerr << "write failed" << std::endl;
+            return 1;
+        }
+    }
+
+    auto loop = std::make_unique<evcpp::EventLoopEpollImpl>();
+    RunAll(loop.get(), file);
+    loop->RunForever();
+
+    ::close(file);
+    return 0;
+}
@@ -0,0 +1,761 @@
+#pragma once
+
+#include <double_link.h>
+#include <event_loop.h>
+#include <libev_impl.h>
+#include <promise.h>
+#include <scheduler.h>
+#include <slab_pool.h>
+#include <timing_wheel.h>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+namespace evcpp {
+
+// a minimal io_uring wrapper on top of the raw syscalls, so there is no
+// dependency on liburing
+class IoUring {
+   public:
+    IoUring()
+        : fd_(-1),
+          sq_ptr_(nullptr),
+          cq_ptr_(nullptr),
+          sqes_(nullptr),
+          sq_len_(0),
+          cq_len_(0),
+          sqes_len_(0),
+          sqe_tail_(0) {}
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() { Close(); }
+
+   public:
+    // returns false when the kernel lacks io_uring, or lacks the features the
+    // loop depends on, e.g. the timeout of io_uring_enter
+    bool Init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            fd_ = -1;
+            return false;
+        }
+
+        if (!(params.features & IORING_FEAT_EXT_ARG)) {
+            Close();
+            return false;
+        }
+
+        sq_len_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_len_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqes_len_ = params.sq_entries * sizeof(io_uring_sqe);
+
+        // the completion ring shares the mapping since linux 5.4
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_len_ = cq_len_ = std::max(sq_len_, cq_len_);
+        }
+
+        sq_ptr_ = Map(sq_len_, IORING_OFF_SQ_RING);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ptr_ = sq_ptr_;
+        } else if (sq_ptr_) {
+            cq_ptr_ = Map(cq_len_, IORING_OFF_CQ_RING);
+        }
+        sqes_ = static_cast<io_uring_sqe*>(Map(sqes_len_, IORING_OFF_SQES));
+
+        if (!sq_ptr_ || !cq_ptr_ || !sqes_) {
+            Close();
+            return false;
+        }
+
+        auto sq = static_cast<char*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sq_entries_ = params.sq_entries;
+
+        auto cq = static_cast<char*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        sqe_tail_ = *sq_tail_;
+
+        return true;
+    }
+
+    void Close() {
+        if (sqes_) {
+            ::munmap(sqes_, sqes_len_);
+        }
+
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+            ::munmap(cq_ptr_, cq_len_);
+        }
+
+        if (sq_ptr_) {
+            ::munmap(sq_ptr_, sq_len_);
+        }
+
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+
+        fd_ = -1;
+        sq_ptr_ = cq_ptr_ = nullptr;
+        sqes_ = nullptr;
+    }
+
+    // the sqe is submitted by the next Enter. when the submission queue is
+    // full, the pending sqes are submitted first
+    io_uring_sqe* GetSqe() {
+        if (sqe_tail_ - Load(sq_head_) >= sq_entries_) {
+            Enter(std::chrono::milliseconds(0));
+
+            if (sqe_tail_ - Load(sq_head_) >= sq_entries_) {
+                return nullptr;
+            }
+        }
+
+        auto idx = sqe_tail_ & sq_mask_;
+        auto sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+
+        sq_array_[idx] = idx;
+        ++sqe_tail_;
+
+        return sqe;
+    }
+
+    // submits all the pending sqes with one syscall, and waits for at least
+    // one cqe unless the timeout is zero. nullopt means no timeout
+    int Enter(std::optional<std::chrono::milliseconds> timeout) {
+        std::atomic_ref<unsigned>(*sq_tail_).store(sqe_tail_,
+                                                  std::memory_order_release);
+        auto to_submit = sqe_tail_ - Load(sq_head_);
+
+        if (timeout && timeout->count() == 0) {
+            if (to_submit == 0) {
+                return 0;
+            }
+
+            return static_cast<int>(::syscall(__NR_io_uring_enter, fd_,
+                                              to_submit, 0, 0, nullptr, 0));
+        }
+
+        __kernel_timespec ts;
+        io_uring_getevents_arg arg;
+        std::memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+
+        if (timeout) {
+            ts.tv_sec = timeout->count() / 1000;
+            ts.tv_nsec = (timeout->count() % 1000) * 1000000;
+            arg.ts = reinterpret_cast<std::uint64_t>(&ts);
+        }
+
+        unsigned flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd_, to_submit,
+                                          1, flags, &arg, sizeof(arg)));
+    }
+
+    // the cqe slot is released before f is invoked, so f may submit more sqes
+    template <typename F>
+    std::size_t ForEachCqe(F&& f) {
+        std::size_t num = 0;
+
+        auto head = *cq_head_;
+        while (head != Load(cq_tail_)) {
+            auto cqe = cqes_[head & cq_mask_];
+            ++head;
+            std::atomic_ref<unsigned>(*cq_head_).store(
+                head, std::memory_order_release);
+
+            f(cqe.user_data, cqe.res, cqe.flags);
+            ++num;
+        }
+
+        return num;
+    }
+
+   private:
+    void* Map(std::size_t len, off_t offset) {
+        auto ptr = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd_, offset);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    static unsigned Load(unsigned* ptr) {
+        return std::atomic_ref<unsigned>(*ptr).load(std::memory_order_acquire);
+    }
+
+    int fd_;
+
+    void* sq_ptr_;
+    void* cq_ptr_;
+    io_uring_sqe* sqes_;
+
+    std::size_t sq_len_;
+    std::size_t cq_len_;
+    std::size_t sqes_len_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_array_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe* cqes_;
+
+    // the local tail, it's published to the kernel by Enter
+    unsigned sqe_tail_;
+};
+
+class EventLoopUringImpl;
+
+// an in-flight submission. the kernel hands the pointer back as the user_data
+// of the cqe, so the operation must live until its last cqe, even if its
+// owner is gone
+struct UringOperation : public DoubleLinkObject<UringOperation> {
+    virtual ~UringOperation() = default;
+
+    // returns true when the operation is done and can be released
+    virtual bool Complete(int res) { return true; }
+
+    // the request is cancelled and reaped by the destruction of the loop
+    virtual void Abort() {}
+};
+
+class IOEventUringImpl : public DoubleLinkObject<IOEventUringImpl>,
+                         public IOEvent,
+                         public PoolAllocated {
+   public:
+    IOEventUringImpl()
+        : type_(IOEventType::kRead),
+          mode_(IOEventMode::kOneShot),
+          cancelled_(false),
+          fired_(false),
+          op_(nullptr),
+          ev_(nullptr) {}
+
+    IOEventUringImpl(EventLoopUringImpl* ev, Fd fd, IOEventType type,
+                     UniqueFunction<void()>&& cb, IOEventMode mode)
+        : fd_(fd),
+          cb_(std::move(cb)),
+          type_(type),
+          mode_(mode),
+          cancelled_(false),
+          fired_(false),
+          op_(nullptr),
+          ev_(ev) {
+        Init();
+    }
+
+    void Cancel() override;
+
+    bool Fired() const override { return fired_; }
+    bool Cancelled() const override { return cancelled_; }
+
+    ~IOEventUringImpl() override { Cancel(); }
+
+   private:
+    struct PollOperation;
+
+    void Init();
+
+    std::uint32_t PollEvents() const {
+        return type_ == IOEventType::kRead ? POLLIN : POLLOUT;
+    }
+
+    Fd fd_;
+    UniqueFunction<void()> cb_;
+    IOEventType type_;
+    IOEventMode mode_;
+
+    bool cancelled_;
+    bool fired_;
+
+    PollOperation* op_;
+    EventLoopUringImpl* ev_;
+
+    friend class EventLoopUringImpl;
+};
+
+struct EventLoopUringOptions {
+    // the size of the submission queue
+    unsigned entries = 256;
+
+    SchedulerOptions scheduler;
+};
+
+// the event loop on top of io_uring. the readiness events are poll requests,
+// the timers live in a timing wheel, and all the submissions of one loop
+// iteration are batched into the io_uring_enter which waits for completions.
+// besides the EventLoop interface, it provides completion-based operations
+class EventLoopUringImpl : public EventLoop {
+   public:
+    explicit EventLoopUringImpl(const EventLoopUringOptions& options = {})
+        : status_(Status::kInit),
+          closing_(false),
+          scheduler_(options.scheduler),
+          notified_(false),
+          event_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          wakeup_op_(this),
+          io_pool_(SlabPool::Create(sizeof(IOEventUringImpl))) {
+        auto ok = ring_.Init(options.entries);
+        ASSERT(ok);
+        ASSERT(event_fd_ >= 0);
+
+        SubmitPoll(&wakeup_op_, event_fd_, POLLIN);
+        tls_loop = this;
+    }
+
+    EventLoopUringImpl(const EventLoopUringImpl&) = delete;
+    EventLoopUringImpl& operator=(const EventLoopUringImpl&) = delete;
+
+    ~EventLoopUringImpl() override {
+        closing_ = true;
+        CancelAllEvents();
+
+        // the kernel owns the buffers of the in-flight requests until their
+        // cqes, so every request is cancelled and reaped before its owner is
+        // failed. the owners are failed exactly once, the pending tasks are
+        // left alone, and the submissions of a resumed coroutine are refused
+        UringOperation::Iterate(&op_head_, [this](UringOperation* op) -> bool {
+            SubmitCancel(op);
+            return true;
+        });
+
+        while (op_head_.next != &op_head_) {
+            if (ring_.Enter(std::nullopt) < 0) {
+                ASSERT(errno == EINTR || errno == EBUSY || errno == EAGAIN);
+            }
+            ring_.ForEachCqe([this](std::uint64_t user_data, int,
+                                    std::uint32_t) {
+                auto op = reinterpret_cast<UringOperation*>(user_data);
+                if (op && op != &wakeup_op_) {
+                    op->Unlink();
+                    op->Abort();
+                    delete op;
+                }
+            });
+        }
+
+        // the wakeup poll is cancelled by closing the ring
+        ring_.Close();
+        ::close(event_fd_);
+
+        if (tls_loop == this) {
+            tls_loop = nullptr;
+        }
+    }
+
+    static bool IsSupported() {
+        static bool supported = []() {
+            IoUring ring;
+            return ring.Init(8);
+        }();
+
+        return supported;
+    }
+
+   public:
+    void Dispatch(UniqueFunction<void()>&& cb,
+                  Priority prio = Priority::kLow) override {
+        scheduler_.Dispatch(std::move(cb), prio);
+
+        // only the first producer since the last drain pays the syscall
+        if (!notified_.exchange(true, std::memory_order_acq_rel)) {
+            std::uint64_t one = 1;
+            auto n = ::write(event_fd_, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    // Post must be invoked in the loop thread, the loop doesn't block while
+    // there are pending tasks
+    void Post(UniqueFunction<void()>&& cb,
+              Priority prio = Priority::kLow) override {
+        scheduler_.Post(std::move(cb), prio);
+    }
+
+    const SchedulerStats& GetSchedulerStats() const {
+        return scheduler_.GetStats();
+    }
+
+    // the event objects are allocated from the pools of the loop
+    const PoolStats& GetTimerPoolStats() const {
+        return timers_.GetPoolStats();
+    }
+
+    const PoolStats& GetIOPoolStats() const { return io_pool_->GetStats(); }
+
+   public:
+    std::unique_ptr<TimerEvent> RunAfter(
+        std::chrono::milliseconds delay,
+        UniqueFunction<void()>&& cb) override {
+        return timers_.Add(delay, std::chrono::milliseconds(0), false,
+                           std::move(cb));
+    }
+
+    std::unique_ptr<TimerEvent> RunEvery(
+        std::chrono::milliseconds interval,
+        UniqueFunction<void()>&& cb) override {
+        return timers_.Add(interval, std::chrono::milliseconds(0), true,
+                           std::move(cb));
+    }
+
+    std::unique_ptr<TimerEvent> RunAfter(
+        std::chrono::milliseconds delay, std::chrono::milliseconds slack,
+        UniqueFunction<void()>&& cb) override {
+        return timers_.Add(delay, slack, false, std::move(cb));
+    }
+
+    std::unique_ptr<TimerEvent> RunEvery(
+        std::chrono::milliseconds interval, std::chrono::milliseconds slack,
+        UniqueFunction<void()>&& cb) override {
+        return timers_.Add(interval, slack, true, std::move(cb));
+    }
+
+   public:
+    std::unique_ptr<IOEvent> AddIOEvent(
+        Fd fd, IOEventType type, UniqueFunction<void()>&& cb,
+        IOEventMode mode = IOEventMode::kOneShot) override {
+        auto event = new (io_pool_.get())
+            IOEventUringImpl(this, fd, type, std::move(cb), mode);
+        return std::unique_ptr<IOEvent>(event);
+    }
+
+   public:
+    // the completion-based operations, the buffers must stay valid until the
+    // returned promise is settled. the ones submitted while the loop is
+    // destroyed never settle, so a coroutine retrying on errors doesn't spin
+    Promise<ssize_t> Read(Fd fd, void* buf, std::size_t size) {
+        Promise<ssize_t> promise(this);
+        if (closing_) {
+            return promise;
+        }
+
+        auto op = new ResultOperation<ssize_t>(promise.GetResolver());
+        auto sqe = PrepareSqe(op, IORING_OP_READ, fd);
+        sqe->addr = reinterpret_cast<std::uint64_t>(buf);
+        sqe->len = static_cast<std::uint32_t>(size);
+        sqe->off = static_cast<std::uint64_t>(-1);
+
+        return promise;
+    }
+
+    Promise<ssize_t> Write(Fd fd, const void* buf, std::size_t size) {
+        Promise<ssize_t> promise(this);
+        if (closing_) {
+            return promise;
+        }
+
+        auto op = new ResultOperation<ssize_t>(promise.GetResolver());
+        auto sqe = PrepareSqe(op, IORING_OP_WRITE, fd);
+        sqe->addr = reinterpret_cast<std::uint64_t>(buf);
+        sqe->len = static_cast<std::uint32_t>(size);
+        sqe->off = static_cast<std::uint64_t>(-1);
+
+        return promise;
+    }
+
+    Promise<Fd> Accept(Fd fd) {
+        Promise<Fd> promise(this);
+        if (closing_) {
+            return promise;
+        }
+
+        auto op = new ResultOperation<Fd>(promise.GetResolver());
+        PrepareSqe(op, IORING_OP_ACCEPT, fd);
+
+        return promise;
+    }
+
+    Promise<void> Connect(Fd fd, const sockaddr* addr, socklen_t len) {
+        Promise<void> promise(this);
+        if (closing_) {
+            return promise;
+        }
+
+        // the address must outlive the submission
+        auto op = new ConnectOperation(promise.GetResolver());
+        std::memcpy(&op->addr, addr, len);
+
+        auto sqe = PrepareSqe(op, IORING_OP_CONNECT, fd);
+        sqe->addr = reinterpret_cast<std::uint64_t>(&op->addr);
+        sqe->off = len;
+
+        return promise;
+    }
+
+   public:
+    // the hooks run at the top of the next iteration, before the timeout of
+    // the backend is computed, so the tasks they post don't wait
+    void ScheduleIterationHook(IterationHook* hook) override {
+        hooks_.Schedule(hook);
+    }
+
+   public:
+    void RunForever() override {
+        status_ = Status::kRunning;
+
+        while (status_ == Status::kRunning) {
+            // the end of the last iteration
+            hooks_.Run();
+
+            std::optional<std::chrono::milliseconds> timeout;
+            if (scheduler_.HasPendingTasks()) {
+                timeout = std::chrono::milliseconds(0);
+            } else {
+                timeout = timers_.NextTimeout();
+            }
+
+            // a timeout or a signal merely ends the wait, and a full
+            // completion queue is drained below. anything else is a broken
+            // ring, which would spin the loop
+            if (ring_.Enter(timeout) < 0) {
+                ASSERT(errno == EINTR || errno == ETIME || errno == EBUSY ||
+                       errno == EAGAIN);
+            }
+            ring_.ForEachCqe([this](std::uint64_t user_data, int res,
+                                    std::uint32_t flags) {
+                auto op = reinterpret_cast<UringOperation*>(user_data);
+                if (op && op->Complete(res)) {
+                    op->Unlink();
+                    delete op;
+                }
+            });
+
+            timers_.Expire();
+            RunPendingTasks();
+        }
+    }
+
+    void Stop() override {
+        Dispatch(MakeCallback([this]() mutable {
+            status_ = Status::kStopping;
+
+            CancelAllEvents();
+
+            status_ = Status::kStopped;
+        }));
+    }
+
+    Status GetStatus() const override { return status_; }
+
+    std::size_t PendingTaskNum() const override {
+        return scheduler_.PendingTaskNum();
+    }
+
+   private:
+    template <typename T>
+    struct ResultOperation : public UringOperation {
+        Resolver<T> resolver;
+
+        explicit ResultOperation(Resolver<T>&& r) : resolver(std::move(r)) {}
+
+        bool Complete(int res) override {
+            if (res < 0) {
+                resolver.Reject(std::error_code(-res, std::generic_category()));
+            } else if constexpr (std::is_void_v<T>) {
+                resolver.Resolve();
+            } else {
+                resolver.Resolve(T(res));
+            }
+
+            return true;
+        }
+
+        // the awaiting coroutine is resumed rather than left hanging
+        void Abort() override {
+            resolver.Reject(
+                std::make_error_code(std::errc::operation_canceled));
+        }
+    };
+
+    struct ConnectOperation : public ResultOperation<void> {
+        sockaddr_storage addr;
+
+        using ResultOperation<void>::ResultOperation;
+    };
+
+    // the eventfd poll, it's owned by the loop and re-armed on every wakeup
+    struct WakeupOperation : public UringOperation {
+        EventLoopUringImpl* ev;
+
+        explicit WakeupOperation(EventLoopUringImpl* e) : ev(e) {}
+
+        bool Complete(int res) override {
+            std::uint64_t value;
+            auto n = ::read(ev->event_fd_, &value, sizeof(value));
+            (void)n;
+
+            ev->SubmitPoll(this, ev->event_fd_, POLLIN);
+            return false;
+        }
+    };
+
+    io_uring_sqe* PrepareSqe(UringOperation* op, std::uint8_t opcode, Fd fd) {
+        if (op != &wakeup_op_ && op->next == op) {
+            op->Link(&op_head_);
+        }
+
+        auto sqe = ring_.GetSqe();
+        ASSERT(sqe != nullptr);
+
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->user_data = reinterpret_cast<std::uint64_t>(op);
+
+        return sqe;
+    }
+
+    // a poll request is one-shot, a persistent event re-arms it on every
+    // completion, so the level-triggered semantic of libev is kept
+    void SubmitPoll(UringOperation* op, Fd fd, std::uint32_t events) {
+        auto sqe = PrepareSqe(op, IORING_OP_POLL_ADD, fd);
+        sqe->poll32_events = events;
+    }
+
+    // the completion of the removal itself is ignored
+    void SubmitPollRemove(UringOperation* op) {
+        auto sqe = ring_.GetSqe();
+        ASSERT(sqe != nullptr);
+
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<std::uint64_t>(op);
+        sqe->user_data = 0;
+    }
+
+    // the completion of the cancellation itself is ignored
+    void SubmitCancel(UringOperation* op) {
+        auto sqe = ring_.GetSqe();
+        ASSERT(sqe != nullptr);
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<std::uint64_t>(op);
+        sqe->user_data = 0;
+    }
+
+    void RunPendingTasks() {
+        notified_.exchange(false, std::memory_order_acq_rel);
+        scheduler_.RunOnce();
+    }
+
+    void CancelAllEvents() {
+        IOEventUringImpl::Iterate(&io_head_,
+                                  [](IOEventUringImpl* event) -> bool {
+                                      event->Cancel();
+                                      return true;
+                                  });
+
+        timers_.CancelAll();
+    }
+
+    Status status_;
+    bool closing_;
+
+    IoUring ring_;
+    TaskScheduler scheduler_;
+    IterationHookList hooks_;
+
+    std::atomic<bool> notified_;
+    Fd event_fd_;
+    WakeupOperation wakeup_op_;
+
+    UringOperation op_head_;
+    IOEventUringImpl io_head_;
+    SlabPool::Ptr io_pool_;
+
+    WheelTimerService timers_;
+
+    friend class IOEventUringImpl;
+};
+
+struct IOEventUringImpl::PollOperation : public UringOperation {
+    IOEventUringImpl* event;
+
+    explicit PollOperation(IOEventUringImpl* e) : event(e) {}
+
+    // the callback may destroy the event, so it's invoked at last
+    bool Complete(int res) override {
+        if (!event) {
+            return true;
+        }
+
+        auto e = event;
+        e->fired_ = true;
+
+        auto rearm = e->mode_ == IOEventMode::kPersistent && res >= 0;
+        if (rearm) {
+            e->ev_->SubmitPoll(this, e->fd_, e->PollEvents());
+        } else {
+            event = nullptr;
+            e->op_ = nullptr;
+            e->Unlink();
+        }
+
+        e->cb_();
+        return !rearm;
+    }
+};
+
+void IOEventUringImpl::Cancel() {
+    if (cancelled_ || !ev_) {
+        return;
+    }
+
+    if (op_) {
+        op_->event = nullptr;
+        ev_->SubmitPollRemove(op_);
+        op_ = nullptr;
+    }
+
+    cancelled_ = true;
+    Unlink();
+}
+
+// an event added while the loop is destroyed never fires
+void IOEventUringImpl::Init() {
+    if (ev_->closing_) {
+        return;
+    }
+
+    op_ = new PollOperation(this);
+    Link(&ev_->io_head_);
+
+    ev_->SubmitPoll(op_, fd_, PollEvents());
+}
+
+// prefers io_uring, and falls back to libev when the kernel lacks it
+inline std::unique_ptr<EventLoop> MakeEventLoop() {
+    if (EventLoopUringImpl::IsSupported()) {
+        return std::make_unique<EventLoopUringImpl>();
+    }
+
+    return std::make_unique<EventLoopLibevImpl>();
+}
+
+}  // namespace evcpp
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <event_loop.h>
+#include <size_class_pool.h>
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace evcpp {
+
+// the blocks are recycled by per-thread free lists, so the connections of a
+// loop borrow a block when data arrives and return it once the data is
+// consumed, without malloc. a block released by another thread joins the
+// free lists of that thread
+using IOBlockPool = SizeClassPool<struct IOBlockPoolTag, 4096, 64 * 1024>;
+using IOBlockPoolStats = IOBlockPool::Stats;
+
+// a refcounted chunk of memory, the data follows the header. the capacity
+// is rounded up to the size class of the pool
+class IOBlock {
+   public:
+    static IOBlock* Create(std::size_t capacity) {
+        auto size = IOBlockPool::AllocationSize(sizeof(IOBlock) + capacity);
+        auto mem = IOBlockPool::Allocate(size);
+        return new (mem) IOBlock(size - sizeof(IOBlock));
+    }
+
+    IOBlock(const IOBlock&) = delete;
+    IOBlock& operator=(const IOBlock&) = delete;
+
+    void AddRef() { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+    void Release() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            auto size = sizeof(IOBlock) + capacity_;
+            this->~IOBlock();
+            IOBlockPool::Deallocate(this, size);
+        }
+    }
+
+    // no one else refers to the block, so its free space may be written
+    bool IsUnique() const {
+        return refs_.load(std::memory_order_acquire) == 1;
+    }
+
+    char* Data() { return reinterpret_cast<char*>(this + 1); }
+    std::size_t Capacity() const { return capacity_; }
+
+   private:
+    explicit IOBlock(std::size_t capacity) : refs_(1), capacity_(capacity) {}
+    ~IOBlock() = default;
+
+    std::atomic<std::uint32_t> refs_;
+    std::size_t capacity_;
+};
+
+// a range of a block, the copies share the block
+class IOSlice {
+   public:
+    IOSlice() = default;
+
+    // takes over a reference of the block
+    IOSlice(IOBlock* block, std::size_t begin, std::size_t end)
+        : block_(block), begin_(begin), end_(end) {}
+
+    IOSlice(const IOSlice& other)
+        : block_(other.block_), begin_(other.begin_), end_(other.end_) {
+        if (block_) {
+            block_->AddRef();
+        }
+    }
+
+    IOSlice(IOSlice&& other) noexcept
+        : block_(std::exchange(other.block_, nullptr)),
+          begin_(other.begin_),
+          end_(other.end_) {}
+
+    IOSlice& operator=(IOSlice other) noexcept {
+        std::swap(block_, other.block_);
+        begin_ = other.begin_;
+        end_ = other.end_;
+        return *this;
+    }
+
+    ~IOSlice() {
+        if (block_) {
+            block_->Release();
+        }
+    }
+
+    const char* Data() const { return block_->Data() + begin_; }
+    std::size_t Size() const { return end_ - begin_; }
+
+    std::size_t Headroom() const { return begin_; }
+    std::size_t Tailroom() const { return block_->Capacity() - end_; }
+    bool IsUnique() const { return block_->IsUnique(); }
+
+   private:
+    friend class IOBuf;
+
+    IOBlock* block_ = nullptr;
+    std::size_t begin_ = 0;
+    std::size_t end_ = 0;
+};
+
+// a chain of slices. slicing, splitting and appending another buffer share
+// the blocks instead of copying the bytes, and the free space around the
+// slices is written in place while the block isn't shared, e.g. a header is
+// prepended into the headroom. the reads and the writes of a socket use
+// readv and writev over the chain. a buffer isn't thread-safe, but the
+// blocks may be shared by the buffers of different threads
+class IOBuf {
+   public:
+    // the size of the blocks allocated when a buffer grows, with the header
+    // it's one size class of the pool
+    static constexpr std::size_t kBlockSize = 16 * 1024 - sizeof(IOBlock);
+
+    // the iovecs passed to one readv or writev
+    static constexpr std::size_t kMaxIovecs = 64;
+
+    IOBuf() = default;
+
+    // a copy shares the blocks
+    IOBuf(const IOBuf& other) : size_(other.size_) {
+        for (auto& slice : other.slices_) {
+            if (slice.Size() > 0) {
+                slices_.push_back(slice);
+            }
+        }
+    }
+
+    IOBuf(IOBuf&& other) noexcept
+        : slices_(std::move(other.slices_)),
+          size_(std::exchange(other.size_, 0)) {
+        other.slices_.clear();
+    }
+
+    IOBuf& operator=(const IOBuf& other) {
+        if (this != &other) {
+            *this = IOBuf(other);
+        }
+        return *this;
+    }
+
+    IOBuf& operator=(IOBuf&& other) noexcept {
+        if (this != &other) {
+            slices_ = std::move(other.slices_);
+            size_ = std::exchange(other.size_, 0);
+            other.slices_.clear();
+        }
+        return *this;
+    }
+
+    // an empty buffer with one block, the headroom is reserved for prepending
+    static IOBuf Create(std::size_t capacity, std::size_t headroom = 0) {
+        IOBuf buf;
+        auto block = IOBlock::Create(capacity + headroom);
+        buf.slices_.emplace_back(block, headroom, headroom);
+        return buf;
+    }
+
+    static IOBuf CopyFrom(const void* data, std::size_t size,
+                          std::size_t headroom = 0) {
+        auto buf = Create(size, headroom);
+        buf.Append(data, size);
+        return buf;
+    }
+
+    static IOBuf CopyFrom(std::string_view str, std::size_t headroom = 0) {
+        return CopyFrom(str.data(), str.size(), headroom);
+    }
+
+    std::size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+
+    // the slices, including the empty ones reserved at the tail
+    const std::vector<IOSlice>& Slices() const { return slices_; }
+
+    void Clear() {
+        slices_.clear();
+        size_ = 0;
+    }
+
+    // copies into the free space of the tail, then into new blocks
+    void Append(const void* data, std::size_t size) {
+        Reserve(size);
+
+        auto src = static_cast<const char*>(data);
+        for (auto i = TailIndex(); size > 0; ++i) {
+            auto& slice = slices_[i];
+            auto n = std::min(size, slice.Tailroom());
+            std::memcpy(slice.block_->Data() + slice.end_, src, n);
+            slice.end_ += n;
+            size_ += n;
+            src += n;
+            size -= n;
+        }
+    }
+
+    void Append(std::string_view str) { Append(str.data(), str.size()); }
+
+    // moves the slices of other to the end, no byte is copied
+    void Append(IOBuf&& other) {
+        ReleaseTail();
+        for (auto& slice : other.slices_) {
+            if (slice.Size() > 0) {
+                slices_.push_back(std::move(slice));
+            }
+        }
+        size_ += std::exchange(other.size_, 0);
+        other.slices_.clear();
+    }
+
+    // shares the blocks of other
+    void Append(const IOBuf& other) { Append(IOBuf(other)); }
+
+    // writes into the headroom of the first slice if it's not shared,
+    // otherwise into a new block at the front, whose headroom is left for
+    // the next prepend
+    void Prepend(const void* data, std::size_t size) {
+        if (!slices_.empty() && slices_.front().IsUnique() &&
+            slices_.front().Headroom() >= size) {
+            auto& slice = slices_.front();
+            slice.begin_ -= size;
+            std::memcpy(slice.block_->Data() + slice.begin_, data, size);
+            size_ += size;
+            return;
+        }
+
+        auto block = IOBlock::Create(std::max(size, kMinPrependBlock));
+        auto capacity = block->Capacity();
+        std::memcpy(block->Data() + capacity - size, data, size);
+        slices_.emplace(slices_.begin(), block, capacity - size, capacity);
+        size_ += size;
+    }
+
+    void Prepend(std::string_view str) { Prepend(str.data(), str.size()); }
+
+    // a buffer sharing the bytes [offset, offset + size)
+    IOBuf Slice(std::size_t offset, std::size_t size) const {
+        ASSERT(offset + size <= size_);
+
+        IOBuf buf;
+        for (auto& slice : slices_) {
+            if (size == 0) {
+                break;
+            }
+            if (offset >= slice.Size()) {
+                offset -= slice.Size();
+                continue;
+            }
+
+            auto n = std::min(size, slice.Size() - offset);
+            IOSlice part(slice);
+            part.begin_ += offset;
+            part.end_ = part.begin_ + n;
+            buf.slices_.push_back(std::move(part));
+            buf.size_ += n;
+
+            offset = 0;
+            size -= n;
+        }
+
+        return buf;
+    }
+
+    // removes the first n bytes and returns them, the slice at the split
+    // point is shared by both buffers
+    IOBuf Split(std::size_t n) {
+        auto front = Slice(0, n);
+        TrimFront(n);
+        return front;
+    }
+
+    void TrimFront(std::size_t n) {
+        ASSERT(n <= size_);
+        size_ -= n;
+
+        std::size_t i = 0;
+        while (n > 0) {
+            auto& slice = slices_[i];
+            auto m = std::min(n, slice.Size());
+            slice.begin_ += m;
+            n -= m;
+            if (slice.Size() == 0) {
+                ++i;
+            }
+        }
+
+        slices_.erase(slices_.begin(), slices_.begin() + i);
+    }
+
+    void TrimBack(std::size_t n) {
+        ASSERT(n <= size_);
+        size_ -= n;
+
+        ReleaseTail();
+        while (n > 0) {
+            auto& slice = slices_.back();
+            auto m = std::min(n, slice.Size());
+            slice.end_ -= m;
+            n -= m;
+            if (slice.Size() == 0) {
+                slices_.pop_back();
+            }
+        }
+    }
+
+    // copies the bytes [offset, offset + size) out, it returns the bytes
+    // copied
+    std::size_t CopyTo(void* dst, std::size_t offset, std::size_t size) const {
+        auto out = static_cast<char*>(dst);
+        std::size_t copied = 0;
+
+        for (auto& slice : slices_) {
+            if (copied == size) {
+                break;
+            }
+            if (offset >= slice.Size()) {
+                offset -= slice.Size();
+                continue;
+            }
+
+            auto n = std::min(size - copied, slice.Size() - offset);
+            std::memcpy(out + copied, slice.Data() + offset, n);
+            copied += n;
+            offset = 0;
+        }
+
+        return copied;
+    }
+
+    std::string ToString() const {
+        std::string str(size_, '\0');
+        CopyTo(str.data(), 0, size_);
+        return str;
+    }
+
+    // the iovecs of the bytes for writev, it returns the count
+    std::size_t FillIovecs(iovec* iov, std::size_t max) const {
+        std::size_t count = 0;
+        for (auto& slice : slices_) {
+            if (count == max) {
+                break;
+            }
+            if (slice.Size() > 0) {
+                iov[count].iov_base = const_cast<char*>(slice.Data());
+                iov[count].iov_len = slice.Size();
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // makes sure at least n bytes can be appended without allocating, the
+    // new blocks stay at the tail as empty slices
+    void Reserve(std::size_t n) {
+        std::size_t available = 0;
+        for (auto i = TailIndex(); i < slices_.size(); ++i) {
+            available += slices_[i].Tailroom();
+        }
+
+        if (available < n) {
+            auto capacity = std::max(kBlockSize, n - available);
+            slices_.emplace_back(IOBlock::Create(capacity), 0, 0);
+        }
+    }
+
+    // the iovecs of the free space at the tail for readv, at most size bytes
+    std::size_t FillTailIovecs(iovec* iov, std::size_t max,
+                               std::size_t size) const {
+        std::size_t count = 0;
+        for (auto i = TailIndex(); i < slices_.size() && count < max; ++i) {
+            if (size == 0) {
+                break;
+            }
+
+            auto& slice = slices_[i];
+            auto n = std::min(size, slice.Tailroom());
+            if (n == 0) {
+                continue;
+            }
+
+            iov[count].iov_base = slice.block_->Data() + slice.end_;
+            iov[count].iov_len = n;
+            ++count;
+            size -= n;
+        }
+        return count;
+    }
+
+    // returns the empty blocks reserved at the tail to the pool, e.g. when
+    // a read would block, so a buffer waiting for data holds no block
+    void ReleaseTail() {
+        while (!slices_.empty() && slices_.back().Size() == 0) {
+            slices_.pop_back();
+        }
+    }
+
+    // appends the n bytes written into the iovecs of FillTailIovecs
+    void Commit(std::size_t n) {
+        size_ += n;
+        for (auto i = TailIndex(); n > 0; ++i) {
+            auto& slice = slices_[i];
+            auto m = std::min(n, slice.Tailroom());
+            slice.end_ += m;
+            n -= m;
+        }
+    }
+
+   private:
+    static constexpr std::size_t kMinPrependBlock = 256;
+
+    // the first slice whose free space may be appended to, that is the last
+    // non-empty slice if its block isn't shared, or the empty slices after
+    // it. the empty slices are never copied, so they aren't shared
+    std::size_t TailIndex() const {
+        auto i = slices_.size();
+        while (i > 0 && slices_[i - 1].Size() == 0) {
+            --i;
+        }
+
+        if (i > 0 && slices_[i - 1].IsUnique() &&
+            slices_[i - 1].Tailroom() > 0) {
+            return i - 1;
+        }
+        return i;
+    }
+
+    std::vector<IOSlice> slices_;
+    std::size_t size_ = 0;
+};
+
+}  // namespace evcpp
@@ -1,64 +1,24 @@
 #pragma once
 
+#include <double_link.h>
 #include <ev.h>
 #include <event_loop.h>
-
-#include <mutex>
-#include <vector>
+#include <scheduler.h>
+#include <slab_pool.h>
+#include <timing_wheel.h>
 
 namespace evcpp {
 
 class EventLoopLibevImpl;
 
-template <typename T>
-struct DoubleLinkObject {
-    T* prev;
-    T* next;
-
-    DoubleLinkObject() : prev(Self()), next(Self()) {}
-
-    void Unlink() {
-        if (prev && next) {
-            prev->next = next;
-            next->prev = prev;
-
-            prev = Self();
-            next = Self();
-        }
-    }
-
-    void Link(T* head) {
-        prev = head;
-        next = head->next;
-        head->next->prev = Self();
-        head->next = Self();
-    }
-
-    static bool Iterate(T* head, std::function<bool(T*)>&& cb) {
-        auto node = head->next;
-        while (node != head) {
-            auto next_node = node->next;
-
-            if (!cb(node)) {
-                return false;
-            }
-
-            node = next_node;
-        }
-
-        return true;
-    }
-
-    auto Self() { return static_cast<T*>(this); }
-};
-
 class TimerEventLibevImpl : public DoubleLinkObject<TimerEventLibevImpl>,
-                            public TimerEvent {
+                            public TimerEvent,
+                            public PoolAllocated {
    public:
     TimerEventLibevImpl()
         : repeat_(false), cancelled_(false), fired_(false), ev_(nullptr) {}
 
-    TimerEventLibevImpl(EventLoopLibevImpl* ev, VariantCallback<void()>&& cb,
+    TimerEventLibevImpl(EventLoopLibevImpl* ev, UniqueFunction<void()>&& cb,
                         std::chrono::milliseconds after, bool repeat)
         : cb_(std::move(cb)),
           after_(after),
@@ -86,20 +46,24 @@ class TimerEventLibevImpl : public DoubleLinkObject<TimerEventLibevImpl>,
    private:
     void Init();
 
+    // the callback may destroy the event, e.g. a coroutine resumed inline
+    // owns it, so it's invoked at last. a fired one-shot timer is detached
+    // from the loop, so its handle may outlive the loop
     static void TimerCallback(EV_P_ ev_timer* w, int revents) {
         auto impl = static_cast<TimerEventLibevImpl*>(w->data);
-
-        InvokeVariantCallback(impl->cb_);
         impl->fired_ = true;
 
         if (!impl->repeat_) {
             ev_timer_stop(EV_A_ w);
             impl->Unlink();
+            impl->ev_ = nullptr;
         }
+
+        impl->cb_();
     }
 
     struct ev_timer watcher_;
-    VariantCallback<void()> cb_;
+    UniqueFunction<void()> cb_;
     std::chrono::milliseconds after_;
 
     bool repeat_;
@@ -110,15 +74,22 @@ class TimerEventLibevImpl : public DoubleLinkObject<TimerEventLibevImpl>,
 };
 
 class IOEventLibevImpl : public DoubleLinkObject<IOEventLibevImpl>,
-                         public IOEvent {
+                         public IOEvent,
+                         public PoolAllocated {
    public:
-    IOEventLibevImpl() : cancelled_(false), fired_(false), ev_(nullptr) {}
+    IOEventLibevImpl()
+        : mode_(IOEventMode::kOneShot),
+          cancelled_(false),
+          fired_(false),
+          ev_(nullptr) {}
 
     IOEventLibevImpl(EventLoopLibevImpl* ev, Fd fd, IOEventType type,
-                     VariantCallback<void()>&& cb)
+                     UniqueFunction<void()>&& cb,
+                     IOEventMode mode = IOEventMode::kOneShot)
         : fd_(fd),
           cb_(std::move(cb)),
           type_(type),
+          mode_(mode),
           cancelled_(false),
           fired_(false),
           ev_(ev) {
@@ -135,21 +106,27 @@ class IOEventLibevImpl : public DoubleLinkObject<IOEventLibevImpl>,
    private:
     void Init();
 
+    // the callback may destroy the event, so it's invoked at last. a fired
+    // one-shot event is detached from the loop like a timer
     static void IOCallback(EV_P_ ev_io* w, int revents) {
         auto impl = static_cast<IOEventLibevImpl*>(w->data);
-
-        InvokeVariantCallback(impl->cb_);
         impl->fired_ = true;
 
-        ev_io_stop(EV_A_ w);
-        impl->Unlink();
+        if (impl->mode_ == IOEventMode::kOneShot) {
+            ev_io_stop(EV_A_ w);
+            impl->Unlink();
+            impl->ev_ = nullptr;
+        }
+
+        impl->cb_();
     }
 
     struct ev_io watcher_;
 
     Fd fd_;
-    VariantCallback<void()> cb_;
+    UniqueFunction<void()> cb_;
     IOEventType type_;
+    IOEventMode mode_;
 
     bool cancelled_;
     bool fired_;
@@ -157,58 +134,168 @@ class IOEventLibevImpl : public DoubleLinkObject<IOEventLibevImpl>,
     EventLoopLibevImpl* ev_;
 };
 
+enum class TimerBackend {
+    // one ev_timer per timer, backed by the heap of libev
+    kHeap,
+    // a hierarchical timing wheel driven by a single ev_timer, with
+    // millisecond ticks
+    kWheel,
+};
+
+struct EventLoopLibevOptions {
+    // the pending tasks are drained by an ev_async watcher, so Post and
+    // Dispatch take effect on the next loop iteration. the sys timer is only a
+    // periodic fallback now, and disabled when the interval is zero
+    std::chrono::milliseconds sys_timer_interval = std::chrono::milliseconds(0);
+
+    SchedulerOptions scheduler;
+
+    TimerBackend timer_backend = TimerBackend::kHeap;
+};
+
 class EventLoopLibevImpl : public EventLoop {
    public:
-    EventLoopLibevImpl(std::chrono::milliseconds sys_timer_interval =
-                           std::chrono::milliseconds(5))
+    explicit EventLoopLibevImpl(const EventLoopLibevOptions& options)
         : status_(Status::kInit),
-          sys_timer_interval_(sys_timer_interval),
+          scheduler_(options.scheduler),
+          timer_backend_(options.timer_backend),
+          wheel_([this](std::uint64_t expire) {
+              if (expire < wheel_armed_) {
+                  ArmWheel();
+              }
+          }),
+          wheel_armed_(kNotArmed),
+          sys_timer_interval_(options.sys_timer_interval),
+          sys_timer_iterations_(0),
+          timer_pool_(SlabPool::Create(sizeof(TimerEventLibevImpl))),
+          io_pool_(SlabPool::Create(sizeof(IOEventLibevImpl))),
           loop_(ev_loop_new(0)) {
         Initialize();
         tls_loop = this;
     }
 
+    EventLoopLibevImpl(std::chrono::milliseconds sys_timer_interval =
+                           std::chrono::milliseconds(0))
+        : EventLoopLibevImpl(EventLoopLibevOptions{
+              .sys_timer_interval = sys_timer_interval}) {}
+
     EventLoopLibevImpl(const EventLoopLibevImpl&) = delete;
     EventLoopLibevImpl& operator=(const EventLoopLibevImpl&) = delete;
 
     ~EventLoopLibevImpl() override {
+        // the events may outlive the loop. the armed ones are cancelled here,
+        // and the fired one-shot ones are already detached
+        CancelAllEvents();
+
+        sys_timer_.reset();
+        ev_async_stop(loop_, &async_watcher_);
+        ev_prepare_stop(loop_, &prepare_watcher_);
+        ev_timer_stop(loop_, &wheel_watcher_);
+
         ev_loop_destroy(loop_);
-        tls_loop = nullptr;
+
+        // the loop may be destroyed in another thread, e.g. EventLoopGroup
+        if (tls_loop == this) {
+            tls_loop = nullptr;
+        }
     }
 
    public:
-    void Dispatch(VariantCallback<void()>&& cb,
+    void Dispatch(UniqueFunction<void()>&& cb,
                   Priority prio = Priority::kLow) override {
-        std::lock_guard<std::mutex> lock(mu_);
-        Post(std::move(cb), prio);
+        scheduler_.Dispatch(std::move(cb), prio);
+
+        // thread-safe, it wakes up the loop if it's blocked in the backend
+        ev_async_send(loop_, &async_watcher_);
     }
 
-    void Post(VariantCallback<void()>&& cb,
+    // Post must be invoked in the loop thread, the local queues are lock-free
+    void Post(UniqueFunction<void()>&& cb,
               Priority prio = Priority::kLow) override {
-        auto idx = static_cast<int>(prio);
-        cbs_[idx].push_back(std::move(cb));
+        scheduler_.Post(std::move(cb), prio);
+
+        // inside the loop thread, libev only marks the watcher pending and
+        // skips the pipe write, so it's cheap
+        ev_async_send(loop_, &async_watcher_);
     }
 
+    const SchedulerStats& GetSchedulerStats() const {
+        return scheduler_.GetStats();
+    }
+
+    // the event objects are allocated from the pools of the loop
+    PoolStats GetTimerPoolStats() const {
+        auto stats = timer_pool_->GetStats();
+        stats += wheel_.GetPoolStats();
+        return stats;
+    }
+
+    const PoolStats& GetIOPoolStats() const { return io_pool_->GetStats(); }
+
    public:
     std::unique_ptr<TimerEvent> RunAfter(
         std::chrono::milliseconds delay,
-        VariantCallback<void()>&& cb) override {
-        return std::unique_ptr<TimerEvent>(
-            new TimerEventLibevImpl(this, std::move(cb), delay, false));
+        UniqueFunction<void()>&& cb) override {
+        if (timer_backend_ == TimerBackend::kWheel) {
+            return wheel_.Add(delay, std::chrono::milliseconds(0), false,
+                              std::move(cb));
+        }
+
+        auto timer = new (timer_pool_.get())
+            TimerEventLibevImpl(this, std::move(cb), delay, false);
+        return std::unique_ptr<TimerEvent>(timer);
     }
 
     std::unique_ptr<TimerEvent> RunEvery(
         std::chrono::milliseconds interval,
-        VariantCallback<void()>&& cb) override {
-        return std::unique_ptr<TimerEvent>(
-            new TimerEventLibevImpl(this, std::move(cb), interval, true));
+        UniqueFunction<void()>&& cb) override {
+        if (timer_backend_ == TimerBackend::kWheel) {
+            return wheel_.Add(interval, std::chrono::milliseconds(0), true,
+                              std::move(cb));
+        }
+
+        auto timer = new (timer_pool_.get())
+            TimerEventLibevImpl(this, std::move(cb), interval, true);
+        return std::unique_ptr<TimerEvent>(timer);
+    }
+
+    // the coalesced timers always live in the timing wheel, whatever the
+    // timer backend is
+    std::unique_ptr<TimerEvent> RunAfter(
+        std::chrono::milliseconds delay, std::chrono::milliseconds slack,
+        UniqueFunction<void()>&& cb) override {
+        if (slack.count() <= 0) {
+            return RunAfter(delay, std::move(cb));
+        }
+
+        return wheel_.Add(delay, slack, false, std::move(cb));
+    }
+
+    std::unique_ptr<TimerEvent> RunEvery(
+        std::chrono::milliseconds interval, std::chrono::milliseconds slack,
+        UniqueFunction<void()>&& cb) override {
+        if (slack.count() <= 0) {
+            return RunEvery(interval, std::move(cb));
+        }
+
+        return wheel_.Add(interval, slack, true, std::move(cb));
     }
 
    public:
-    std::unique_ptr<IOEvent> AddIOEvent(Fd fd, IOEventType type,
-                                        VariantCallback<void()>&& cb) override {
-        return std::unique_ptr<IOEvent>(
-            new IOEventLibevImpl(this, fd, type, std::move(cb)));
+    std::unique_ptr<IOEvent> AddIOEvent(
+        Fd fd, IOEventType type, UniqueFunction<void()>&& cb,
+        IOEventMode mode = IOEventMode::kOneShot) override {
+        return std::unique_ptr<IOEvent>(new (io_pool_.get()) IOEventLibevImpl(
+            this, fd, type, std::move(cb), mode));
+    }
+
+   public:
+    // the hooks are run by an ev_prepare watcher, which is only active while
+    // a hook is scheduled
+    void ScheduleIterationHook(IterationHook* hook) override {
+        if (hooks_.Schedule(hook) && !ev_is_active(&prepare_watcher_)) {
+            ev_prepare_start(loop_, &prepare_watcher_);
+        }
     }
 
    public:
@@ -231,47 +318,76 @@ class EventLoopLibevImpl : public EventLoop {
 
     Status GetStatus() const override { return status_; }
 
+    std::size_t PendingTaskNum() const override {
+        return scheduler_.PendingTaskNum();
+    }
+
    private:
     void Initialize() {
-        sys_timer_ =
-            RunEvery(sys_timer_interval_,
-                     MakeCallback([this]() mutable { SysTimerCallback(); }));
+        ev_async_init(&async_watcher_, AsyncCallback);
+        async_watcher_.data = this;
+        ev_async_start(loop_, &async_watcher_);
+
+        ev_init(&wheel_watcher_, WheelCallback);
+        wheel_watcher_.data = this;
+
+        ev_prepare_init(&prepare_watcher_, PrepareCallback);
+        prepare_watcher_.data = this;
+
+        if (sys_timer_interval_.count() > 0) {
+            sys_timer_ = RunEvery(
+                sys_timer_interval_,
+                MakeCallback([this]() mutable { SysTimerCallback(); }));
+        }
+    }
+
+    static void AsyncCallback(EV_P_ ev_async* w, int revents) {
+        auto impl = static_cast<EventLoopLibevImpl*>(w->data);
+        impl->RunPendingTasks();
+    }
+
+    static void PrepareCallback(EV_P_ ev_prepare* w, int revents) {
+        auto impl = static_cast<EventLoopLibevImpl*>(w->data);
+        impl->hooks_.Run();
+        ev_prepare_stop(EV_A_ w);
     }
 
     void SysTimerCallback() {
         sys_timer_iterations_++;
+        RunPendingTasks();
+    }
 
-        std::vector<VariantCallback<void()>> cbs;
-        {
-            std::lock_guard<std::mutex> lock(mu_);
-            cbs.swap(cbs_[0]);
+    // when the budget is exhausted, the remaining tasks wait for the next
+    // iteration, which polls the backend without blocking
+    void RunPendingTasks() {
+        if (scheduler_.RunOnce()) {
+            ev_async_send(loop_, &async_watcher_);
         }
+    }
 
-        high_task_num_ += RunTasks(std::move(cbs));
+    void ArmWheel() {
+        ev_timer_stop(loop_, &wheel_watcher_);
+        wheel_armed_ = kNotArmed;
 
-        cbs.clear();
-        {
-            std::lock_guard<std::mutex> lock(mu_);
-            cbs.swap(cbs_[1]);
+        auto next = wheel_.NextExpiry();
+        if (!next) {
+            return;
         }
 
-        medium_task_num_ += RunTasks(std::move(cbs));
+        wheel_armed_ = *next;
 
-        cbs.clear();
-        {
-            std::lock_guard<std::mutex> lock(mu_);
-            cbs.swap(cbs_[2]);
-        }
-
-        low_task_num_ += RunTasks(std::move(cbs));
+        auto now = WheelTimerService::NowTick();
+        auto after = wheel_armed_ > now ? (wheel_armed_ - now) / 1000.0 : 0.0;
+        ev_timer_set(&wheel_watcher_, after, 0.0);
+        ev_timer_start(loop_, &wheel_watcher_);
     }
 
-    std::uint64_t RunTasks(std::vector<VariantCallback<void()>>&& cbs) {
-        for (auto& cb : cbs) {
-            InvokeVariantCallback(cb);
-        }
+    static void WheelCallback(EV_P_ ev_timer* w, int revents) {
+        auto impl = static_cast<EventLoopLibevImpl*>(w->data);
+        impl->wheel_armed_ = kNotArmed;
 
-        return cbs.size();
+        impl->wheel_.Expire();
+        impl->ArmWheel();
     }
 
     void CancelAllEvents() {
@@ -286,24 +402,36 @@ class EventLoopLibevImpl : public EventLoop {
                                          event->Cancel();
                                          return true;
                                      });
+
+        wheel_.CancelAll();
     }
 
     Status status_;
 
-    std::array<std::vector<VariantCallback<void()>>, 3> cbs_;
+    TaskScheduler scheduler_;
+
+    struct ev_async async_watcher_;
 
-    std::mutex mu_;
+    IterationHookList hooks_;
+    struct ev_prepare prepare_watcher_;
 
     IOEventLibevImpl io_head_;
     TimerEventLibevImpl timer_head_;
 
+    static constexpr std::uint64_t kNotArmed = UINT64_MAX;
+
+    TimerBackend timer_backend_;
+    WheelTimerService wheel_;
+    struct ev_timer wheel_watcher_;
+    std::uint64_t wheel_armed_;
+
     std::chrono::milliseconds sys_timer_interval_;
     std::unique_ptr<TimerEvent> sys_timer_;
 
     std::uint64_t sys_timer_iterations_;
-    std::uint64_t high_task_num_;
-    std::uint64_t medium_task_num_;
-    std::uint64_t low_task_num_;
+
+    SlabPool::Ptr timer_pool_;
+    SlabPool::Ptr io_pool_;
 
     struct ev_loop* loop_;
 
@@ -312,7 +440,12 @@ class EventLoopLibevImpl : public EventLoop {
 };
 
 void TimerEventLibevImpl::Cancel() {
-    if (cancelled_ || !ev_) {
+    if (cancelled_) {
+        return;
+    }
+
+    if (!ev_) {
+        cancelled_ = true;
         return;
     }
 
@@ -332,7 +465,12 @@ void TimerEventLibevImpl::Init() {
 }
 
 void IOEventLibevImpl::Cancel() {
-    if (cancelled_ || !ev_) {
+    if (cancelled_) {
+        return;
+    }
+
+    if (!ev_) {
+        cancelled_ = true;
         return;
     }
 
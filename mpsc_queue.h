@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+
+namespace evcpp {
+
+struct MpscNode {
+    std::atomic<MpscNode*> next{nullptr};
+};
+
+// intrusive multi-producer single-consumer queue, based on Dmitry Vyukov's
+// non-blocking algorithm. Push is wait-free and can be invoked from any thread,
+// Pop must only be invoked from the consumer thread. the node type T must
+// derive from MpscNode, and the queue never owns the nodes
+template <typename T>
+class MpscQueue {
+   public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void Push(T* node) { PushNode(node); }
+
+    // returns nullptr when the queue is empty. it also returns nullptr when a
+    // producer is in the middle of a push, the producer is expected to notify
+    // the consumer after the push completes
+    T* Pop() {
+        MpscNode* tail = tail_;
+        MpscNode* next = tail->next.load(std::memory_order_acquire);
+
+        if (tail == &stub_) {
+            if (!next) {
+                return nullptr;
+            }
+
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+
+        if (next) {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+
+        if (tail != head_.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+
+        PushNode(&stub_);
+
+        next = tail->next.load(std::memory_order_acquire);
+        if (next) {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+
+        return nullptr;
+    }
+
+    bool Empty() const {
+        return tail_ == &stub_ &&
+               !stub_.next.load(std::memory_order_acquire);
+    }
+
+   private:
+    void PushNode(MpscNode* node) {
+        node->next.store(nullptr, std::memory_order_relaxed);
+
+        auto prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // producers side
+    alignas(64) std::atomic<MpscNode*> head_;
+
+    // consumer side
+    alignas(64) MpscNode* tail_;
+    MpscNode stub_;
+};
+
+}  // namespace evcpp
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <socket.h>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace evcpp {
+
+// a non-blocking pipe, the kernel buffer between the splices of two sockets,
+// so the bytes moved from one to the other never reach the user memory
+class Pipe {
+   public:
+    // duplicates at most size bytes into the other pipe like the plain Tee,
+    // but waits while this pipe is empty or the other one is full. zero
+    // means this pipe is empty and its write end is closed
+    class TeeAwaiter {
+       public:
+        TeeAwaiter(EventLoop* loop, Pipe* from, Pipe* to, std::size_t size)
+            : loop_(loop), from_(from), to_(to), size_(size) {}
+
+        bool await_ready() { return Try(); }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            handle_ = h;
+            Arm();
+        }
+
+        Result<std::size_t> await_resume() { return std::move(res_); }
+
+       private:
+        bool Try() {
+            auto r = from_->Tee(*to_, size_);
+            if (!r && r.Error() == std::errc::resource_unavailable_try_again) {
+                return false;
+            }
+
+            res_ = std::move(r);
+            return true;
+        }
+
+        // EAGAIN doesn't tell which side blocks, so an empty pipe waits for
+        // data and a non-empty one for room in the other
+        void Arm() {
+            auto buffered = from_->Size();
+            auto empty = buffered && buffered.Value() == 0;
+
+            event_ = loop_->AddIOEvent(
+                empty ? from_->ReadFd() : to_->WriteFd(),
+                empty ? IOEventType::kRead : IOEventType::kWrite,
+                MakeCallback([this]() { OnReady(); }));
+        }
+
+        // the resumed coroutine may destroy the awaiter, so it's resumed at
+        // last
+        void OnReady() {
+            if (!Try()) {
+                Arm();
+                return;
+            }
+
+            event_.reset();
+            ResumeCoroutine(loop_, std::exchange(handle_, {}));
+        }
+
+        EventLoop* loop_;
+        Pipe* from_;
+        Pipe* to_;
+        std::size_t size_;
+        std::coroutine_handle<> handle_;
+        std::unique_ptr<IOEvent> event_;
+        Result<std::size_t> res_;
+    };
+
+    Pipe() = default;
+
+    Pipe(Pipe&& other) noexcept
+        : read_fd_(std::exchange(other.read_fd_, -1)),
+          write_fd_(std::exchange(other.write_fd_, -1)) {}
+    Pipe(const Pipe&) = delete;
+
+    Pipe& operator=(Pipe&& other) noexcept {
+        if (this != &other) {
+            Close();
+            read_fd_ = std::exchange(other.read_fd_, -1);
+            write_fd_ = std::exchange(other.write_fd_, -1);
+        }
+        return *this;
+    }
+    Pipe& operator=(const Pipe&) = delete;
+
+    ~Pipe() { Close(); }
+
+    static Result<Pipe> Create() {
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+            return LastError();
+        }
+
+        Pipe pipe;
+        pipe.read_fd_ = fds[0];
+        pipe.write_fd_ = fds[1];
+        return pipe;
+    }
+
+    Fd ReadFd() const { return read_fd_; }
+    Fd WriteFd() const { return write_fd_; }
+    bool IsOpen() const { return read_fd_ >= 0; }
+
+    // the kernel rounds the capacity up to pages, a larger pipe moves more
+    // bytes per splice
+    Result<std::size_t> SetCapacity(std::size_t size) {
+        auto n = ::fcntl(write_fd_, F_SETPIPE_SZ, int(size));
+        if (n < 0) {
+            return LastError();
+        }
+        return std::size_t(n);
+    }
+
+    Result<std::size_t> Capacity() const {
+        auto n = ::fcntl(write_fd_, F_GETPIPE_SZ);
+        if (n < 0) {
+            return LastError();
+        }
+        return std::size_t(n);
+    }
+
+    // the bytes buffered in the pipe
+    Result<std::size_t> Size() const {
+        int n = 0;
+        if (::ioctl(read_fd_, FIONREAD, &n) < 0) {
+            return LastError();
+        }
+        return std::size_t(n);
+    }
+
+    // duplicates at most size bytes into the other pipe without consuming
+    // them, e.g. to mirror a stream to a second socket. it fails with
+    // EAGAIN if this pipe is empty or the other one is full
+    Result<std::size_t> Tee(Pipe& to, std::size_t size) {
+        while (true) {
+            auto n = ::tee(read_fd_, to.write_fd_, size, SPLICE_F_NONBLOCK);
+            if (n >= 0) {
+                return std::size_t(n);
+            }
+            if (errno != EINTR) {
+                return LastError();
+            }
+        }
+    }
+
+    [[nodiscard]] TeeAwaiter Tee(EventLoop* loop, Pipe& to, std::size_t size) {
+        return TeeAwaiter(loop, this, &to, size);
+    }
+
+    void Close() {
+        if (read_fd_ >= 0) {
+            ::close(std::exchange(read_fd_, -1));
+        }
+        if (write_fd_ >= 0) {
+            ::close(std::exchange(write_fd_, -1));
+        }
+    }
+
+   private:
+    Fd read_fd_ = -1;
+    Fd write_fd_ = -1;
+};
+
+}  // namespace evcpp
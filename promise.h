@@ -1,18 +1,27 @@
 #pragma once
 
 #include <event_loop.h>
+#include <size_class_pool.h>
 
+#include <atomic>
 #include <coroutine>
+#include <cstdint>
 #include <exception>
 #include <functional>
 #include <memory>
 #include <optional>
+#include <thread>
+#include <utility>
 
 namespace evcpp {
 
 template <typename T, typename E>
 class Promise;
 
+// the promise states are at most a few hundred bytes
+using PromisePool = SizeClassPool<struct PromisePoolTag, 16, 512>;
+using PromisePoolStats = PromisePool::Stats;
+
 template <typename T>
 struct IsPromise : std::false_type {};
 
@@ -28,13 +37,169 @@ enum class PromiseStatus {
     kCancelled,
 };
 
-class PromiseStateBase : public std::enable_shared_from_this<PromiseStateBase> {
+enum class PromiseMode {
+    // the reference counts are atomic, the resolver may be used in another
+    // thread, e.g. a worker pool
+    kShared,
+    // the reference counts are plain loads and stores. the promise, its
+    // resolvers and the chained promises must stay in the creating thread,
+    // which is checked in debug builds
+    kLocal,
+};
+
+inline thread_local PromiseMode tls_promise_mode = PromiseMode::kShared;
+
+// the mode of the promises created without an explicit one, per thread. e.g.
+// a loop whose promises never cross threads switches to kLocal once
+inline PromiseMode DefaultPromiseMode() { return tls_promise_mode; }
+inline void SetDefaultPromiseMode(PromiseMode mode) { tls_promise_mode = mode; }
+
+// a strong reference of a promise state, the counterpart of std::shared_ptr
+template <typename S>
+class PromiseStatePtr {
+   public:
+    PromiseStatePtr() noexcept : ptr_(nullptr) {}
+
+    // a new state, which starts with one strong reference
+    template <typename... Args>
+    static PromiseStatePtr Make(Args&&... args) {
+        return PromiseStatePtr(new S(std::forward<Args>(args)...), false);
+    }
+
+    // one more strong reference of an alive state
+    static PromiseStatePtr FromThis(S* ptr) {
+        ptr->AddRef();
+        return PromiseStatePtr(ptr, false);
+    }
+
+    PromiseStatePtr(const PromiseStatePtr& other) : ptr_(other.ptr_) {
+        if (ptr_) {
+            ptr_->AddRef();
+        }
+    }
+
+    PromiseStatePtr(PromiseStatePtr&& other) noexcept : ptr_(other.ptr_) {
+        other.ptr_ = nullptr;
+    }
+
+    template <typename U, typename = std::enable_if_t<
+                              std::is_convertible_v<U*, S*>>>
+    PromiseStatePtr(PromiseStatePtr<U>&& other) noexcept
+        : ptr_(other.Detach()) {}
+
+    PromiseStatePtr& operator=(PromiseStatePtr other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        return *this;
+    }
+
+    ~PromiseStatePtr() { reset(); }
+
+   public:
+    S* get() const noexcept { return ptr_; }
+    S* operator->() const noexcept { return ptr_; }
+    S& operator*() const noexcept { return *ptr_; }
+    explicit operator bool() const noexcept { return ptr_ != nullptr; }
+
+    void reset() {
+        if (ptr_) {
+            std::exchange(ptr_, nullptr)->Release();
+        }
+    }
+
+   private:
+    // adopts the reference
+    PromiseStatePtr(S* ptr, bool) noexcept : ptr_(ptr) {}
+
+    S* Detach() noexcept { return std::exchange(ptr_, nullptr); }
+
+    S* ptr_;
+
+    template <typename _S>
+    friend class PromiseStatePtr;
+
+    template <typename _S>
+    friend class PromiseStateWeakPtr;
+};
+
+// a weak reference of a promise state, the counterpart of std::weak_ptr
+template <typename S>
+class PromiseStateWeakPtr {
+   public:
+    PromiseStateWeakPtr() noexcept : ptr_(nullptr) {}
+
+    explicit PromiseStateWeakPtr(S* ptr) : ptr_(ptr) {
+        if (ptr_) {
+            ptr_->AddWeakRef();
+        }
+    }
+
+    PromiseStateWeakPtr(const PromiseStatePtr<S>& other)
+        : PromiseStateWeakPtr(other.get()) {}
+
+    PromiseStateWeakPtr(const PromiseStateWeakPtr& other)
+        : PromiseStateWeakPtr(other.ptr_) {}
+
+    PromiseStateWeakPtr(PromiseStateWeakPtr&& other) noexcept
+        : ptr_(std::exchange(other.ptr_, nullptr)) {}
+
+    PromiseStateWeakPtr& operator=(PromiseStateWeakPtr other) noexcept {
+        std::swap(ptr_, other.ptr_);
+        return *this;
+    }
+
+    ~PromiseStateWeakPtr() {
+        if (ptr_) {
+            ptr_->ReleaseWeak();
+        }
+    }
+
+   public:
+    PromiseStatePtr<S> lock() const {
+        if (ptr_ && ptr_->TryAddRef()) {
+            return PromiseStatePtr<S>(ptr_, false);
+        }
+
+        return PromiseStatePtr<S>();
+    }
+
+   private:
+    S* ptr_;
+};
+
+// the promise state is reference counted intrusively. the payload is
+// disposed with the last strong reference, and the object is deleted with the
+// last weak reference. the strong references together hold one weak reference
+class PromiseStateBase {
    public:
-    PromiseStateBase(PromiseStatus status, Executor* exec)
-        : status_(status), exec_(exec), next_(nullptr), prev_() {}
+    PromiseStateBase(PromiseStatus status, Executor* exec,
+                     PromiseMode mode = PromiseMode::kShared)
+        : status_(status),
+          exec_(exec),
+          next_(nullptr),
+          prev_(),
+          strong_(1),
+          weak_(1),
+          mode_(mode) {
+#ifndef NDEBUG
+        owner_ = std::this_thread::get_id();
+#endif
+    }
 
     virtual ~PromiseStateBase() { BreakPromiseChain(); }
 
+    PromiseStateBase(const PromiseStateBase&) = delete;
+    PromiseStateBase& operator=(const PromiseStateBase&) = delete;
+
+    // the states are allocated from the free lists of PromisePool, the
+    // virtual destructor passes the size of the dynamic type
+    static void* operator new(std::size_t size) {
+        return PromisePool::Allocate(size);
+    }
+
+    static void operator delete(void* ptr, std::size_t size) {
+        PromisePool::Deallocate(ptr, size);
+    }
+
     struct Propagator {
         virtual ~Propagator() {}
 
@@ -73,7 +238,7 @@ class PromiseStateBase : public std::enable_shared_from_this<PromiseStateBase> {
 
     // the previous Promise holds the next shared_ptr
     void Watch(PromiseStateBase* other) {
-        prev_ = other->shared_from_this();
+        prev_ = PromiseStatePtr<PromiseStateBase>::FromThis(other);
         other->next_ = this;
     }
 
@@ -88,26 +253,117 @@ class PromiseStateBase : public std::enable_shared_from_this<PromiseStateBase> {
         co_handle_ = handle;
     }
 
+    PromiseMode GetMode() const { return mode_; }
+
+   public:
+    void AddRef() { Increase(strong_); }
+
+    void Release() {
+        if (Decrease(strong_) == 0) {
+            Dispose();
+            ReleaseWeak();
+        }
+    }
+
+    // it fails once the payload is disposed, like weak_ptr::lock
+    bool TryAddRef() {
+        CheckThread();
+
+        if (mode_ == PromiseMode::kLocal) {
+            auto n = strong_.load(std::memory_order_relaxed);
+            if (n == 0) {
+                return false;
+            }
+
+            strong_.store(n + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        auto n = strong_.load(std::memory_order_relaxed);
+        while (n != 0) {
+            if (strong_.compare_exchange_weak(n, n + 1,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void AddWeakRef() { Increase(weak_); }
+
+    void ReleaseWeak() {
+        if (Decrease(weak_) == 0) {
+            delete this;
+        }
+    }
+
    protected:
+    // releases everything but the object itself, e.g. the callback which may
+    // hold a weak reference to this state
+    virtual void Dispose() { BreakPromiseChain(); }
+
     PromiseStatus status_;
     Executor* exec_;
 
     // although a Promise<void, E> cannot link promises backwards,
     // but it may still link promise<T, E> forwards
     PromiseStateBase* next_;
-    std::shared_ptr<PromiseStateBase> prev_;
+    PromiseStatePtr<PromiseStateBase> prev_;
 
     // it used to cancel promise and release the resource of coroutine
     std::coroutine_handle<> co_handle_;
+
+   private:
+    void CheckThread() const {
+#ifndef NDEBUG
+        if (mode_ == PromiseMode::kLocal) {
+            ASSERT(owner_ == std::this_thread::get_id());
+        }
+#endif
+    }
+
+    void Increase(std::atomic<std::uint32_t>& count) {
+        CheckThread();
+
+        if (mode_ == PromiseMode::kLocal) {
+            count.store(count.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_relaxed);
+        } else {
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::uint32_t Decrease(std::atomic<std::uint32_t>& count) {
+        CheckThread();
+
+        if (mode_ == PromiseMode::kLocal) {
+            auto n = count.load(std::memory_order_relaxed) - 1;
+            count.store(n, std::memory_order_relaxed);
+            return n;
+        }
+
+        return count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+
+    std::atomic<std::uint32_t> strong_;
+    std::atomic<std::uint32_t> weak_;
+    PromiseMode mode_;
+
+#ifndef NDEBUG
+    std::thread::id owner_;
+#endif
 };
 
 template <typename T, typename E>
 class PromiseStateInternal : public PromiseStateBase {
    public:
-    using Callback = VariantCallback<void(Result<T, E>&&)>;
+    using Callback = UniqueFunction<void(Result<T, E>&&)>;
 
-    PromiseStateInternal(PromiseStatus status, Executor* exec)
-        : PromiseStateBase(status, exec) {}
+    PromiseStateInternal(PromiseStatus status, Executor* exec,
+                         PromiseMode mode)
+        : PromiseStateBase(status, exec, mode) {}
 
     bool OnCancel() override {
         cb_ = std::nullopt;
@@ -135,30 +391,68 @@ class PromiseStateInternal : public PromiseStateBase {
             return;
         }
 
-        auto cb = std::move(cb_.value());
-        cb_ = std::nullopt;
-
-        auto val = std::move(storage_.value());
-        storage_ = std::nullopt;
-
         if (status_ == PromiseStatus::kPreResolved) {
             status_ = PromiseStatus::kResolved;
         } else if (status_ == PromiseStatus::kPreRejected) {
             status_ = PromiseStatus::kRejected;
         }
 
-        RunInExecutor(WrapVariantCallback(std::move(cb), std::move(val)));
-    }
-
-    void RunInExecutor(VariantCallback<void()>&& cb) {
+        // without an executor, the callback is invoked in place
         if (exec_) {
-            exec_->Post(std::move(cb));
+            exec_->Post(InvokeTask(this));
         } else {
-            InvokeVariantCallback(cb);
+            InvokeCallback();
         }
     }
 
    protected:
+    // the callback and the result stay in the state until the posted task
+    // runs, so the task is a weak reference which is always stored inline.
+    // a disposed state skips the callback, as the callback itself would
+    class InvokeTask {
+       public:
+        explicit InvokeTask(PromiseStateInternal* stat) : stat_(stat) {}
+
+        void operator()() {
+            if (auto stat = stat_.lock(); stat) {
+                stat->InvokeCallback();
+            }
+        }
+
+       private:
+        PromiseStateWeakPtr<PromiseStateInternal> stat_;
+    };
+
+    static_assert(sizeof(InvokeTask) <= kCallableInlineSize &&
+                      std::is_nothrow_move_constructible_v<InvokeTask>,
+                  "the posted task must be stored inline");
+
+    void InvokeCallback() {
+        if (!cb_.has_value() || !storage_.has_value()) {
+            return;
+        }
+
+        auto cb = std::move(cb_.value());
+        cb_ = std::nullopt;
+
+        auto val = std::move(storage_.value());
+        storage_ = std::nullopt;
+
+        cb(std::move(val));
+    }
+
+    void Dispose() override {
+        PromiseStateBase::Dispose();
+
+        cb_ = std::nullopt;
+        storage_ = std::nullopt;
+    }
+
+    // weak references for the callbacks, they don't keep the state alive
+    PromiseStateWeakPtr<PromiseStateBase> WeakFromThis() {
+        return PromiseStateWeakPtr<PromiseStateBase>(this);
+    }
+
     std::optional<Result<T, E>> storage_;
     std::optional<Callback> cb_;
 };
@@ -171,14 +465,9 @@ class PromiseState : public PromiseStateInternal<T, E>,
 
     static_assert(!std::is_same_v<E, void>, "E must not be void");
 
-    explicit PromiseState(Executor* exec = nullptr)
-        : Base(PromiseStatus::kInit, exec) {}
-
-    PromiseState(PromiseState&&) = default;
-    PromiseState& operator=(PromiseState&&) = default;
-
-    PromiseState(const PromiseState&) = delete;
-    PromiseState& operator=(const PromiseState&) = delete;
+    explicit PromiseState(Executor* exec = nullptr,
+                          PromiseMode mode = PromiseMode::kShared)
+        : Base(PromiseStatus::kInit, exec, mode) {}
 
    public:
     bool Reject(E&& err) {
@@ -223,7 +512,7 @@ class PromiseState : public PromiseStateInternal<T, E>,
     template <typename F, typename R = std::invoke_result_t<F, T>,
               std::enable_if_t<std::is_void<R>::value, int> _ = 0>
     void Attach(F&& callback, Executor* exec) {
-        auto weak_promise = this->weak_from_this();
+        auto weak_promise = this->WeakFromThis();
         auto cb = [f = std::forward<F>(callback),
                    weak_promise = std::move(weak_promise)](
                       Result<T, E>&& v) mutable -> void {
@@ -246,7 +535,7 @@ class PromiseState : public PromiseStateInternal<T, E>,
     void Attach(PromiseState<_U, _E>* next, F&& callback, Executor* exec) {
         next->Watch(this);
 
-        auto weak_state = this->weak_from_this();
+        auto weak_state = this->WeakFromThis();
         auto cb = [f = std::forward<F>(callback),
                    weak_state = std::move(weak_state)](
                       Result<T, E>&& v) mutable -> void {
@@ -274,7 +563,7 @@ class PromiseState : public PromiseStateInternal<T, E>,
     void Attach(PromiseState<_U, _E>* next, F&& callback, Executor* exec) {
         next->Watch(this);
 
-        auto weak_state = this->weak_from_this();
+        auto weak_state = this->WeakFromThis();
         auto cb = [f = std::forward<F>(callback),
                    weak_state = std::move(weak_state)](
                       Result<T, E>&& v) mutable -> void {
@@ -305,14 +594,9 @@ class PromiseState<void, E> : public PromiseStateInternal<void, E> {
 
     static_assert(!std::is_same_v<E, void>, "E must not be void");
 
-    explicit PromiseState(Executor* exec = nullptr)
-        : PromiseStateInternal<void, E>(PromiseStatus::kInit, exec) {}
-
-    PromiseState(PromiseState&&) = default;
-    PromiseState& operator=(PromiseState&&) = default;
-
-    PromiseState(const PromiseState&) = delete;
-    PromiseState& operator=(const PromiseState&) = delete;
+    explicit PromiseState(Executor* exec = nullptr,
+                          PromiseMode mode = PromiseMode::kShared)
+        : PromiseStateInternal<void, E>(PromiseStatus::kInit, exec, mode) {}
 
    public:
     bool Reject(E&& err) {
@@ -349,7 +633,7 @@ class PromiseState<void, E> : public PromiseStateInternal<void, E> {
     void Attach(F&& callback, Executor* exec) {
         static_assert(std::is_same_v<R, void>, "callback must return void");
 
-        auto weak_promise = this->weak_from_this();
+        auto weak_promise = this->WeakFromThis();
         auto cb = [f = std::forward<F>(callback),
                    weak_promise = std::move(weak_promise)](
                       Result<void, E>&& v) mutable -> void {
@@ -365,7 +649,7 @@ class PromiseState<void, E> : public PromiseStateInternal<void, E> {
 template <typename T, typename E = std::error_code>
 class Resolver {
    public:
-    Resolver(const std::shared_ptr<PromiseState<T, E>>& ptr) : stat_(ptr) {}
+    Resolver(const PromiseStatePtr<PromiseState<T, E>>& ptr) : stat_(ptr) {}
 
     Resolver(Resolver&&) = default;
     Resolver(const Resolver&) = default;
@@ -404,13 +688,14 @@ class Resolver {
     }
 
    private:
-    std::weak_ptr<PromiseState<T, E>> stat_;
+    PromiseStateWeakPtr<PromiseState<T, E>> stat_;
 };
 
 template <typename E>
 class Resolver<void, E> {
    public:
-    Resolver(const std::shared_ptr<PromiseState<void, E>>& ptr) : stat_(ptr) {}
+    Resolver(const PromiseStatePtr<PromiseState<void, E>>& ptr)
+        : stat_(ptr) {}
 
     Resolver(Resolver&&) = default;
     Resolver(const Resolver&) = default;
@@ -448,7 +733,7 @@ class Resolver<void, E> {
     }
 
    private:
-    std::weak_ptr<PromiseState<void, E>> stat_;
+    PromiseStateWeakPtr<PromiseState<void, E>> stat_;
 };
 
 template <typename T, typename E = std::error_code>
@@ -458,10 +743,11 @@ class Promise {
     using ErrorType = E;
     using ResolverType = Resolver<T, E>;
 
-    explicit Promise(Executor* exec = nullptr)
-        : stat_(std::make_shared<PromiseState<T, E>>(exec)) {}
+    explicit Promise(Executor* exec = nullptr,
+                     PromiseMode mode = DefaultPromiseMode())
+        : stat_(PromiseStatePtr<PromiseState<T, E>>::Make(exec, mode)) {}
 
-    explicit Promise(std::shared_ptr<PromiseState<T, E>>&& stat)
+    explicit Promise(PromiseStatePtr<PromiseState<T, E>>&& stat)
         : stat_(std::move(stat)) {}
 
     Promise(Promise&&) = default;
@@ -484,7 +770,7 @@ class Promise {
                      Promise<typename R::ValueType, typename R::ErrorType>>
     Then(F&& callback, Executor* exec = nullptr) {
         Promise<typename R::ValueType, typename R::ErrorType> next_promise(
-            PreferExecutor(exec));
+            PreferExecutor(exec), stat_->GetMode());
         stat_->Attach(next_promise.StatPtr(), std::forward<F>(callback), exec);
         return next_promise;
     }
@@ -495,7 +781,7 @@ class Promise {
                      Promise<typename R::ValueType, typename R::ErrorType>>
     Then(F&& callback, Executor* exec = nullptr) {
         Promise<typename R::ValueType, typename R::ErrorType> next_promise(
-            PreferExecutor(exec));
+            PreferExecutor(exec), stat_->GetMode());
         stat_->Attach(next_promise.StatPtr(), std::forward<F>(callback), exec);
         return next_promise;
     }
@@ -514,15 +800,17 @@ class Promise {
     Executor* GetExecutor() { return stat_->GetExecutor(); }
     const Executor* GetExecutor() const { return stat_->GetExecutor(); }
 
+    PromiseMode GetMode() const { return stat_->GetMode(); }
+
    private:
     PromiseState<T, E>* StatPtr() { return stat_.get(); }
-    std::shared_ptr<PromiseState<T, E>> SharedPtr() { return stat_; }
+    PromiseStatePtr<PromiseState<T, E>> SharedPtr() { return stat_; }
 
     Executor* PreferExecutor(Executor* prefer) {
         return prefer ? prefer : GetExecutor();
     }
 
-    std::shared_ptr<PromiseState<T, E>> stat_;
+    PromiseStatePtr<PromiseState<T, E>> stat_;
 
     friend class PromiseState<T, E>;
 
@@ -548,10 +836,11 @@ class Promise<void, E> {
     using ValueType = void;
     using ErrorType = E;
 
-    explicit Promise(Executor* exec = nullptr)
-        : stat_(std::make_shared<PromiseState<void, E>>(exec)) {}
+    explicit Promise(Executor* exec = nullptr,
+                     PromiseMode mode = DefaultPromiseMode())
+        : stat_(PromiseStatePtr<PromiseState<void, E>>::Make(exec, mode)) {}
 
-    explicit Promise(std::shared_ptr<PromiseState<void, E>>&& stat)
+    explicit Promise(PromiseStatePtr<PromiseState<void, E>>&& stat)
         : stat_(std::move(stat)) {}
 
     Promise(Promise&&) = default;
@@ -581,15 +870,17 @@ class Promise<void, E> {
     Executor* GetExecutor() { return stat_->GetExecutor(); }
     const Executor* GetExecutor() const { return stat_->GetExecutor(); }
 
+    PromiseMode GetMode() const { return stat_->GetMode(); }
+
    private:
     PromiseState<void, E>* StatPtr() { return stat_.get(); }
-    std::shared_ptr<PromiseState<void, E>> SharedPtr() { return stat_; }
+    PromiseStatePtr<PromiseState<void, E>> SharedPtr() { return stat_; }
 
     Executor* PreferExecutor(Executor* prefer) {
         return prefer ? prefer : GetExecutor();
     }
 
-    std::shared_ptr<PromiseState<void, E>> stat_;
+    PromiseStatePtr<PromiseState<void, E>> stat_;
 
     friend class PromiseState<void, E>;
 
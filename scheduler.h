@@ -0,0 +1,220 @@
+#pragma once
+
+#include <event_loop.h>
+#include <mpsc_queue.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+namespace evcpp {
+
+struct SchedulerOptions {
+    // the max number of tasks run per loop iteration, 0 means unlimited.
+    // an iteration never runs more tasks than were pending when it started
+    std::size_t max_tasks_per_tick = 1024;
+
+    // the max time spent on tasks per loop iteration, 0 means unlimited
+    std::chrono::microseconds max_time_per_tick = std::chrono::microseconds(0);
+
+    // a task waiting for more than aging_ticks iterations is promoted to the
+    // next higher priority, 0 disables aging
+    std::uint32_t aging_ticks = 8;
+};
+
+struct SchedulerStats {
+    std::uint64_t ticks = 0;
+    std::uint64_t budget_exhausted = 0;
+    std::uint64_t promoted = 0;
+    std::array<std::uint64_t, 3> tasks = {0, 0, 0};
+};
+
+// the priority task queues of a loop. Post and RunOnce must be invoked in the
+// loop thread, Dispatch can be invoked from any thread. the owner is expected
+// to wake up the loop after Dispatch, and to call RunOnce again in the next
+// iteration when it returns true
+class TaskScheduler {
+   public:
+    explicit TaskScheduler(const SchedulerOptions& options = {})
+        : options_(options), tick_(0), local_pending_(0), remote_pending_(0) {}
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    ~TaskScheduler() {
+        for (auto& queue : remote_tasks_) {
+            while (auto task = queue.Pop()) {
+                delete task;
+            }
+        }
+    }
+
+   public:
+    void Post(UniqueFunction<void()>&& cb, Priority prio) {
+        auto idx = static_cast<int>(prio);
+        tasks_[idx].push_back(Task{std::move(cb), tick_});
+        PublishLocalPending();
+    }
+
+    void Dispatch(UniqueFunction<void()>&& cb, Priority prio) {
+        auto idx = static_cast<int>(prio);
+        remote_pending_.fetch_add(1, std::memory_order_relaxed);
+        remote_tasks_[idx].Push(new RemoteTask(std::move(cb)));
+    }
+
+    // runs the pending tasks in strict priority order until the budget is
+    // exhausted, returns true if there are still pending tasks
+    bool RunOnce() {
+        ++tick_;
+        ++stats_.ticks;
+
+        std::size_t pending = 0;
+        for (int idx = kHigh; idx >= kLow; --idx) {
+            TakeRemoteTasks(idx);
+            pending += tasks_[idx].size();
+        }
+
+        Promote();
+
+        auto budget = pending;
+        if (options_.max_tasks_per_tick > 0 &&
+            options_.max_tasks_per_tick < budget) {
+            budget = options_.max_tasks_per_tick;
+        }
+
+        auto has_deadline = options_.max_time_per_tick.count() > 0;
+        auto deadline = has_deadline ? std::chrono::steady_clock::now() +
+                                           options_.max_time_per_tick
+                                     : std::chrono::steady_clock::time_point();
+
+        std::size_t executed = 0;
+        while (executed < budget) {
+            auto idx = HighestPriority();
+            if (idx < 0) {
+                break;
+            }
+
+            auto cb = std::move(tasks_[idx].front().cb);
+            tasks_[idx].pop_front();
+
+            cb();
+            ++stats_.tasks[idx];
+            ++executed;
+
+            // reading the clock per task is too expensive for tiny tasks
+            if (has_deadline && (executed & 15) == 0 &&
+                std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+        }
+
+        if (executed < pending) {
+            ++stats_.budget_exhausted;
+        }
+
+        PublishLocalPending();
+        return HasPendingTasks();
+    }
+
+    // the approximate number of pending tasks, it's safe to be invoked from
+    // any thread, e.g. to pick the least loaded loop
+    std::size_t PendingTaskNum() const {
+        return local_pending_.load(std::memory_order_relaxed) +
+               remote_pending_.load(std::memory_order_relaxed);
+    }
+
+    bool HasPendingTasks() const {
+        for (auto idx = 0; idx < kLevels; ++idx) {
+            if (!tasks_[idx].empty() || !remote_tasks_[idx].Empty()) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const SchedulerStats& GetStats() const { return stats_; }
+    const SchedulerOptions& GetOptions() const { return options_; }
+
+   private:
+    static constexpr int kLow = static_cast<int>(Priority::kLow);
+    static constexpr int kHigh = static_cast<int>(Priority::kHigh);
+    static constexpr int kLevels = kHigh + 1;
+
+    struct Task {
+        UniqueFunction<void()> cb;
+        std::uint64_t tick;
+    };
+
+    struct RemoteTask : public MpscNode {
+        UniqueFunction<void()> cb;
+
+        explicit RemoteTask(UniqueFunction<void()>&& c) : cb(std::move(c)) {}
+    };
+
+    // moves the remote tasks behind the local tasks of the same priority
+    void TakeRemoteTasks(int idx) {
+        std::size_t num = 0;
+        while (auto task = remote_tasks_[idx].Pop()) {
+            tasks_[idx].push_back(Task{std::move(task->cb), tick_});
+            delete task;
+            ++num;
+        }
+
+        if (num > 0) {
+            remote_pending_.fetch_sub(num, std::memory_order_relaxed);
+        }
+    }
+
+    // only the loop thread writes it, so a plain store is enough
+    void PublishLocalPending() {
+        std::size_t num = 0;
+        for (auto& tasks : tasks_) {
+            num += tasks.size();
+        }
+
+        local_pending_.store(num, std::memory_order_relaxed);
+    }
+
+    // the queues are FIFO, so the aged tasks are always at the front
+    void Promote() {
+        if (options_.aging_ticks == 0) {
+            return;
+        }
+
+        for (int idx = kLow + 1; idx <= kHigh; ++idx) {
+            auto& from = tasks_[idx - 1];
+            while (!from.empty() &&
+                   tick_ - from.front().tick > options_.aging_ticks) {
+                tasks_[idx].push_back(Task{std::move(from.front().cb), tick_});
+                from.pop_front();
+                ++stats_.promoted;
+            }
+        }
+    }
+
+    int HighestPriority() const {
+        for (int idx = kHigh; idx >= kLow; --idx) {
+            if (!tasks_[idx].empty()) {
+                return idx;
+            }
+        }
+
+        return -1;
+    }
+
+    SchedulerOptions options_;
+
+    std::array<std::deque<Task>, kLevels> tasks_;
+    std::array<MpscQueue<RemoteTask>, kLevels> remote_tasks_;
+
+    std::uint64_t tick_;
+    SchedulerStats stats_;
+
+    std::atomic<std::size_t> local_pending_;
+    std::atomic<std::size_t> remote_pending_;
+};
+
+}  // namespace evcpp
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <event_loop_group.h>
+#include <tcp.h>
+
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace evcpp {
+
+enum class AcceptSteering {
+    // the kernel hashes the 4-tuple of a connection over the listeners
+    kHash,
+
+    // a cbpf program picks the listener by the cpu which handles the
+    // connection, the cpu i goes to the listener i % n. with pin_loops,
+    // the connection stays on the cpu of its rx queue
+    kCpu,
+};
+
+struct ShardedTcpListenerOptions {
+    int backlog = SOMAXCONN;
+    AcceptSteering steering = AcceptSteering::kHash;
+
+    // pins the loop i of the group to the cpu i % cpus
+    bool pin_loops = false;
+
+    // the wait before accepting again after e.g. EMFILE, the pending
+    // connection would otherwise wake up the loop over and over
+    std::chrono::milliseconds retry_delay{100};
+};
+
+// one SO_REUSEPORT listener per loop of a group, all of the same address,
+// each with its own accept coroutine. the kernel spreads the connections
+// over the listeners, so the accept rate scales with the loops, and every
+// connection is handled by the loop which accepted it
+class ShardedTcpListener {
+   public:
+    // invoked in the loop of the stream, by all the loops at the same time
+    using Handler = std::function<void(TcpStream)>;
+
+    ShardedTcpListener() = default;
+
+    ShardedTcpListener(ShardedTcpListener&&) = default;
+    ShardedTcpListener& operator=(ShardedTcpListener&& other) noexcept {
+        if (this != &other) {
+            Close();
+            shards_ = std::move(other.shards_);
+            addr_ = other.addr_;
+        }
+        return *this;
+    }
+
+    ~ShardedTcpListener() { Close(); }
+
+    // the port of the listeners is the one of addr, or a port picked by the
+    // first listener if it's 0
+    static Result<ShardedTcpListener> Listen(
+        EventLoopGroup* group, const InetAddress& addr, Handler handler,
+        const ShardedTcpListenerOptions& options = {}) {
+        TcpListenerOptions listener_options;
+        listener_options.backlog = options.backlog;
+        listener_options.reuse_port = true;
+
+        ShardedTcpListener sharded;
+        sharded.addr_ = addr;
+
+        for (std::size_t i = 0; i < group->Size(); ++i) {
+            auto r = TcpListener::Listen(group->At(i), sharded.addr_,
+                                         listener_options);
+            if (!r) {
+                return std::move(r.Error());
+            }
+
+            if (i == 0) {
+                sharded.addr_ = r.Value().LocalAddress().Value();
+            }
+
+            auto shard = std::make_shared<Shard>();
+            shard->listener = std::move(r.Value());
+            shard->handler = handler;
+            shard->retry_delay = options.retry_delay;
+            sharded.shards_.push_back(std::move(shard));
+        }
+
+        // the program belongs to the reuseport group, so it's attached once
+        if (options.steering == AcceptSteering::kCpu) {
+            if (auto ec = AttachCpuSteering(&sharded.shards_[0]->listener,
+                                            group->Size());
+                ec) {
+                return ec;
+            }
+        }
+
+        for (std::size_t i = 0; i < group->Size(); ++i) {
+            group->At(i)->Dispatch(MakeCallback(
+                [shard = sharded.shards_[i], i, pin = options.pin_loops]() {
+                    if (pin) {
+                        PinToCpu(i);
+                    }
+                    AcceptLoop(shard);
+                }));
+        }
+
+        return std::move(sharded);
+    }
+
+    InetAddress LocalAddress() const { return addr_; }
+
+    std::size_t Size() const { return shards_.size(); }
+
+    // the connections accepted by every loop, a view of how evenly the
+    // kernel spreads them
+    std::vector<std::size_t> AcceptedPerLoop() const {
+        std::vector<std::size_t> accepted;
+        for (auto& shard : shards_) {
+            accepted.push_back(
+                shard->accepted.load(std::memory_order_relaxed));
+        }
+        return accepted;
+    }
+
+    // the listeners are closed in their loops, the accepted streams are
+    // left alone
+    void Close() {
+        for (auto& shard : shards_) {
+            shard->listener.GetLoop()->Dispatch(
+                MakeCallback([shard]() { shard->listener.Close(); }));
+        }
+        shards_.clear();
+    }
+
+   private:
+    // shared with the accept coroutine, which may outlive the sharded
+    // listener until its loop closes the listener
+    struct Shard {
+        TcpListener listener;
+        Handler handler;
+        std::chrono::milliseconds retry_delay;
+        std::atomic<std::size_t> accepted{0};
+    };
+
+    // resumes the coroutine after the delay, in the same loop
+    class RetryAwaiter {
+       public:
+        RetryAwaiter(EventLoop* loop, std::chrono::milliseconds delay)
+            : loop_(loop), delay_(delay) {}
+
+        bool await_ready() const { return false; }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            timer_ = loop_->RunAfter(delay_,
+                                     MakeCallback([h]() { h.resume(); }));
+        }
+
+        void await_resume() const {}
+
+       private:
+        EventLoop* loop_;
+        std::chrono::milliseconds delay_;
+        std::unique_ptr<TimerEvent> timer_;
+    };
+
+    static Promise<void> AcceptLoop(std::shared_ptr<Shard> shard) {
+        while (true) {
+            auto r = co_await shard->listener.Accept();
+            if (r) {
+                shard->accepted.fetch_add(1, std::memory_order_relaxed);
+                shard->handler(std::move(r.Value()));
+                continue;
+            }
+
+            if (r.Error() == std::errc::operation_canceled ||
+                !shard->listener.IsOpen()) {
+                break;
+            }
+
+            // out of fds or memory, the pending connections wait
+            co_await RetryAwaiter(shard->listener.GetLoop(),
+                                  shard->retry_delay);
+        }
+
+        co_return Result<void>();
+    }
+
+    // returns the cpu of the connection modulo the listeners, the index of
+    // a socket in the reuseport group is its order of listen
+    static std::error_code AttachCpuSteering(TcpListener* listener,
+                                             std::size_t num) {
+        std::uint32_t cpu = SKF_AD_OFF + SKF_AD_CPU;
+        sock_filter code[] = {
+            {BPF_LD | BPF_W | BPF_ABS, 0, 0, cpu},
+            {BPF_ALU | BPF_MOD | BPF_K, 0, 0, std::uint32_t(num)},
+            {BPF_RET | BPF_A, 0, 0, 0},
+        };
+
+        sock_fprog prog = {};
+        prog.len = sizeof(code) / sizeof(code[0]);
+        prog.filter = code;
+
+        if (::setsockopt(listener->GetFd(), SOL_SOCKET,
+                         SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+            return LastError();
+        }
+        return {};
+    }
+
+    static void PinToCpu(std::size_t idx) {
+        auto cpus = std::max(1u, std::thread::hardware_concurrency());
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(idx % cpus, &set);
+        ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    }
+
+    std::vector<std::shared_ptr<Shard>> shards_;
+    InetAddress addr_;
+};
+
+}  // namespace evcpp
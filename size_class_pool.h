@@ -0,0 +1,170 @@
+#pragma once
+
+#include <event_loop.h>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+
+namespace evcpp {
+
+// per-thread free lists of small objects, one per size class of Granularity
+// bytes up to MaxSize, the larger ones go to malloc. a block freed by another
+// thread simply joins the free list of that thread, since every block comes
+// from malloc. the free lists are capped, and the blocks beyond the capacity
+// go back to malloc. the Tag separates the pools of different users, e.g.
+// the promise states and the coroutine frames
+template <typename Tag, std::size_t Granularity, std::size_t MaxSize>
+class SizeClassPool {
+   public:
+    static constexpr std::size_t kGranularity = Granularity;
+    static constexpr std::size_t kMaxSize = MaxSize;
+    static constexpr std::size_t kClasses = kMaxSize / kGranularity;
+
+    static_assert(kMaxSize % kGranularity == 0);
+
+    struct Stats {
+        // the allocations served by the free lists, and the ones by malloc
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+
+        // allocations minus deallocations of this thread, it's the number of
+        // live objects when they die in the thread which creates them
+        std::int64_t live = 0;
+
+        // the blocks kept in the free lists
+        std::size_t cached = 0;
+
+        // the allocations per size class, the last one counts the sizes
+        // beyond MaxSize, and the largest size requested
+        std::array<std::uint64_t, kClasses + 1> sizes = {};
+        std::size_t largest = 0;
+    };
+
+    static void* Allocate(std::size_t size) {
+        auto cache = Local();
+        if (cache) {
+            ++cache->stats.sizes[size > kMaxSize ? kClasses : Index(size)];
+            cache->stats.largest = std::max(cache->stats.largest, size);
+        }
+
+        if (!cache || size > kMaxSize) {
+            if (cache) {
+                ++cache->stats.misses;
+                ++cache->stats.live;
+            }
+
+            return Malloc(size);
+        }
+
+        ++cache->stats.live;
+
+        auto idx = Index(size);
+        if (auto block = cache->heads[idx]; block) {
+            cache->heads[idx] = block->next;
+            --cache->counts[idx];
+            --cache->stats.cached;
+            ++cache->stats.hits;
+            return block;
+        }
+
+        ++cache->stats.misses;
+        return Malloc((idx + 1) * kGranularity);
+    }
+
+    static void Deallocate(void* ptr, std::size_t size) {
+        auto cache = Local();
+        if (!cache || size > kMaxSize) {
+            if (cache) {
+                --cache->stats.live;
+            }
+
+            std::free(ptr);
+            return;
+        }
+
+        --cache->stats.live;
+
+        auto idx = Index(size);
+        if (cache->counts[idx] >= cache->capacity) {
+            std::free(ptr);
+            return;
+        }
+
+        auto block = static_cast<FreeBlock*>(ptr);
+        block->next = cache->heads[idx];
+        cache->heads[idx] = block;
+        ++cache->counts[idx];
+        ++cache->stats.cached;
+    }
+
+    // the size of the block actually allocated for size, the caller may use
+    // all of it
+    static constexpr std::size_t AllocationSize(std::size_t size) {
+        return size > kMaxSize ? size : (Index(size) + 1) * kGranularity;
+    }
+
+    // the stats of the calling thread
+    static Stats GetStats() {
+        auto cache = Local();
+        return cache ? cache->stats : Stats{};
+    }
+
+    // the maximum cached blocks per size class of the calling thread, the
+    // default is 1024
+    static void SetCapacity(std::size_t capacity) {
+        if (auto cache = Local(); cache) {
+            cache->capacity = capacity;
+        }
+    }
+
+   private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct Cache {
+        FreeBlock* heads[kClasses] = {};
+        std::size_t counts[kClasses] = {};
+        std::size_t capacity = 1024;
+        Stats stats;
+
+        ~Cache() {
+            for (auto head : heads) {
+                while (head) {
+                    std::free(std::exchange(head, head->next));
+                }
+            }
+
+            destroyed = true;
+        }
+    };
+
+    static constexpr std::size_t Index(std::size_t size) {
+        return size == 0 ? 0 : (size - 1) / kGranularity;
+    }
+
+    static void* Malloc(std::size_t size) {
+        auto ptr = std::malloc(size);
+        ASSERT(ptr != nullptr);
+        return ptr;
+    }
+
+    // nullptr once the cache is destroyed at thread exit, then the blocks
+    // freed later go to malloc directly
+    static Cache* Local() {
+        if (destroyed) {
+            return nullptr;
+        }
+
+        thread_local Cache cache;
+        return &cache;
+    }
+
+    static inline thread_local bool destroyed = false;
+};
+
+}  // namespace evcpp
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <event_loop.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace evcpp {
+
+struct PoolStats {
+    // the objects allocated from the pool, and the ones served by a freed block
+    std::uint64_t allocs = 0;
+    std::uint64_t reuses = 0;
+
+    // the allocations of the global heap, it stays flat in steady state
+    std::uint64_t slabs = 0;
+
+    std::size_t live = 0;
+
+    PoolStats& operator+=(const PoolStats& other) {
+        allocs += other.allocs;
+        reuses += other.reuses;
+        slabs += other.slabs;
+        live += other.live;
+        return *this;
+    }
+};
+
+// fixed-size blocks carved out of slabs, for the event objects of one loop.
+// every block is preceded by a header pointing to its pool, so the class
+// operator delete returns an object without knowing the pool. it's not
+// thread-safe, the objects must be destroyed in the loop thread
+class SlabPool {
+   public:
+    // the owner closes the pool instead of deleting it, since the objects
+    // may outlive the loop. the pool is gone with the last one of them
+    struct Closer {
+        void operator()(SlabPool* pool) const { pool->Close(); }
+    };
+
+    using Ptr = std::unique_ptr<SlabPool, Closer>;
+
+    static Ptr Create(std::size_t block_size,
+                      std::size_t blocks_per_slab = 64) {
+        return Ptr(new SlabPool(block_size, blocks_per_slab));
+    }
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+   public:
+    void* Allocate(std::size_t size) {
+        ASSERT(size <= block_size_);
+
+        ++stats_.allocs;
+        ++stats_.live;
+
+        Block* block;
+        if (free_) {
+            block = free_;
+            free_ = block->next;
+            ++stats_.reuses;
+        } else {
+            if (fresh_num_ == 0) {
+                Grow();
+            }
+
+            block = fresh_;
+            fresh_ += stride_;
+            --fresh_num_;
+        }
+
+        block->pool = this;
+
+        return block + 1;
+    }
+
+    static void Deallocate(void* ptr) {
+        if (!ptr) {
+            return;
+        }
+
+        auto block = static_cast<Block*>(ptr) - 1;
+        auto pool = block->pool;
+
+        block->next = pool->free_;
+        pool->free_ = block;
+
+        --pool->stats_.live;
+        if (pool->closed_ && pool->stats_.live == 0) {
+            delete pool;
+        }
+    }
+
+    const PoolStats& GetStats() const { return stats_; }
+
+   private:
+    // the header of a block, it's the link of the free list while the block
+    // is free
+    struct alignas(std::max_align_t) Block {
+        union {
+            SlabPool* pool;
+            Block* next;
+        };
+    };
+
+    SlabPool(std::size_t block_size, std::size_t blocks_per_slab)
+        : block_size_(block_size),
+          stride_(1 + (block_size + sizeof(Block) - 1) / sizeof(Block)),
+          blocks_per_slab_(blocks_per_slab),
+          free_(nullptr),
+          fresh_(nullptr),
+          fresh_num_(0),
+          closed_(false) {}
+
+    ~SlabPool() = default;
+
+    void Grow() {
+        slabs_.emplace_back(new Block[stride_ * blocks_per_slab_]);
+        ++stats_.slabs;
+
+        fresh_ = slabs_.back().get();
+        fresh_num_ = blocks_per_slab_;
+    }
+
+    void Close() {
+        closed_ = true;
+        if (stats_.live == 0) {
+            delete this;
+        }
+    }
+
+    std::size_t block_size_;
+
+    // in units of Block, including the header
+    std::size_t stride_;
+    std::size_t blocks_per_slab_;
+
+    // the free list is LIFO, so a block is reused while it's still hot
+    Block* free_;
+
+    // the untouched blocks of the last slab
+    Block* fresh_;
+    std::size_t fresh_num_;
+
+    bool closed_;
+
+    std::vector<std::unique_ptr<Block[]>> slabs_;
+    PoolStats stats_;
+};
+
+// the base of the classes allocated by `new (pool) T(...)`, then a plain
+// delete, e.g. via std::unique_ptr<TimerEvent>, returns the block to its pool
+struct PoolAllocated {
+    static void* operator new(std::size_t size, SlabPool* pool) {
+        return pool->Allocate(size);
+    }
+
+    static void operator delete(void* ptr) { SlabPool::Deallocate(ptr); }
+
+    // only invoked when the constructor throws
+    static void operator delete(void* ptr, SlabPool*) {
+        SlabPool::Deallocate(ptr);
+    }
+};
+
+}  // namespace evcpp
@@ -0,0 +1,415 @@
+#pragma once
+
+#include <coroutine.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+
+namespace evcpp {
+
+inline std::error_code LastError() {
+    return std::error_code(errno, std::generic_category());
+}
+
+// an ipv4 or ipv6 socket address
+class InetAddress {
+   public:
+    InetAddress() = default;
+
+    // the ip is in the numeric form, e.g. "127.0.0.1" or "::1"
+    static Result<InetAddress> Parse(const std::string& ip,
+                                     std::uint16_t port) {
+        InetAddress addr;
+
+        auto in4 = reinterpret_cast<sockaddr_in*>(&addr.storage_);
+        if (::inet_pton(AF_INET, ip.c_str(), &in4->sin_addr) == 1) {
+            in4->sin_family = AF_INET;
+            in4->sin_port = htons(port);
+            addr.size_ = sizeof(sockaddr_in);
+            return addr;
+        }
+
+        auto in6 = reinterpret_cast<sockaddr_in6*>(&addr.storage_);
+        if (::inet_pton(AF_INET6, ip.c_str(), &in6->sin6_addr) == 1) {
+            in6->sin6_family = AF_INET6;
+            in6->sin6_port = htons(port);
+            addr.size_ = sizeof(sockaddr_in6);
+            return addr;
+        }
+
+        return std::make_error_code(std::errc::invalid_argument);
+    }
+
+    // the wildcard address of ipv4, or ipv6 which also accepts ipv4
+    static InetAddress Any(std::uint16_t port, bool ipv6 = false) {
+        return Parse(ipv6 ? "::" : "0.0.0.0", port).Value();
+    }
+
+    static InetAddress Loopback(std::uint16_t port, bool ipv6 = false) {
+        return Parse(ipv6 ? "::1" : "127.0.0.1", port).Value();
+    }
+
+    static InetAddress FromSockAddr(const sockaddr* sa, socklen_t size) {
+        InetAddress addr;
+        ASSERT(size <= sizeof(addr.storage_));
+        std::memcpy(&addr.storage_, sa, size);
+        addr.size_ = size;
+        return addr;
+    }
+
+    const sockaddr* Data() const {
+        return reinterpret_cast<const sockaddr*>(&storage_);
+    }
+    sockaddr* Data() { return reinterpret_cast<sockaddr*>(&storage_); }
+
+    socklen_t Size() const { return size_; }
+    int Family() const { return storage_.ss_family; }
+
+    std::uint16_t Port() const {
+        if (Family() == AF_INET6) {
+            return ntohs(reinterpret_cast<const sockaddr_in6*>(&storage_)
+                             ->sin6_port);
+        }
+        return ntohs(reinterpret_cast<const sockaddr_in*>(&storage_)->sin_port);
+    }
+
+    // "ip:port", or "[ip]:port" for ipv6
+    std::string ToString() const {
+        char buf[INET6_ADDRSTRLEN] = {};
+        if (Family() == AF_INET6) {
+            auto in6 = reinterpret_cast<const sockaddr_in6*>(&storage_);
+            ::inet_ntop(AF_INET6, &in6->sin6_addr, buf, sizeof(buf));
+            return "[" + std::string(buf) + "]:" + std::to_string(Port());
+        }
+
+        auto in4 = reinterpret_cast<const sockaddr_in*>(&storage_);
+        ::inet_ntop(AF_INET, &in4->sin_addr, buf, sizeof(buf));
+        return std::string(buf) + ":" + std::to_string(Port());
+    }
+
+   private:
+    sockaddr_storage storage_ = {};
+    socklen_t size_ = 0;
+};
+
+// the owner of a socket fd, with the socket options. the setters return an
+// empty error code on success
+class Socket {
+   public:
+    Socket() = default;
+    explicit Socket(Fd fd) : fd_(fd) {}
+
+    Socket(Socket&& other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+    Socket(const Socket&) = delete;
+
+    Socket& operator=(Socket&& other) noexcept {
+        if (this != &other) {
+            Close();
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+    Socket& operator=(const Socket&) = delete;
+
+    ~Socket() { Close(); }
+
+    // a non-blocking and close-on-exec socket
+    static Result<Socket> Create(int family, int type, int protocol = 0) {
+        auto fd = ::socket(family, type | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                           protocol);
+        if (fd < 0) {
+            return LastError();
+        }
+        return Socket(fd);
+    }
+
+    static std::error_code SetNonBlocking(Fd fd) {
+        auto flags = ::fcntl(fd, F_GETFL);
+        if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            return LastError();
+        }
+        return {};
+    }
+
+    Fd GetFd() const { return fd_; }
+    bool IsOpen() const { return fd_ >= 0; }
+
+    // gives up the ownership of the fd
+    Fd Release() { return std::exchange(fd_, -1); }
+
+    void Close() {
+        if (fd_ >= 0) {
+            ::close(std::exchange(fd_, -1));
+        }
+    }
+
+    std::error_code SetOption(int level, int name, int value) {
+        if (::setsockopt(fd_, level, name, &value, sizeof(value)) < 0) {
+            return LastError();
+        }
+        return {};
+    }
+
+    Result<int> GetOption(int level, int name) const {
+        int value = 0;
+        socklen_t size = sizeof(value);
+        if (::getsockopt(fd_, level, name, &value, &size) < 0) {
+            return LastError();
+        }
+        return int(value);
+    }
+
+    // disables the nagle algorithm, the small writes are sent at once
+    std::error_code SetNoDelay(bool on) {
+        return SetOption(IPPROTO_TCP, TCP_NODELAY, on);
+    }
+
+    std::error_code SetKeepAlive(bool on) {
+        return SetOption(SOL_SOCKET, SO_KEEPALIVE, on);
+    }
+
+    // enables the keepalive, the first probe is sent after idle, then every
+    // interval, and the connection is dropped after count unanswered probes
+    std::error_code SetKeepAlive(std::chrono::seconds idle,
+                                 std::chrono::seconds interval, int count) {
+        if (auto ec = SetKeepAlive(true); ec) {
+            return ec;
+        }
+        if (auto ec = SetOption(IPPROTO_TCP, TCP_KEEPIDLE, idle.count()); ec) {
+            return ec;
+        }
+        if (auto ec = SetOption(IPPROTO_TCP, TCP_KEEPINTVL, interval.count());
+            ec) {
+            return ec;
+        }
+        return SetOption(IPPROTO_TCP, TCP_KEEPCNT, count);
+    }
+
+    std::error_code SetSendBufferSize(int size) {
+        return SetOption(SOL_SOCKET, SO_SNDBUF, size);
+    }
+
+    std::error_code SetReceiveBufferSize(int size) {
+        return SetOption(SOL_SOCKET, SO_RCVBUF, size);
+    }
+
+    std::error_code SetReuseAddr(bool on) {
+        return SetOption(SOL_SOCKET, SO_REUSEADDR, on);
+    }
+
+    std::error_code SetReusePort(bool on) {
+        return SetOption(SOL_SOCKET, SO_REUSEPORT, on);
+    }
+
+    Result<InetAddress> LocalAddress() const {
+        InetAddress addr;
+        socklen_t size = sizeof(sockaddr_storage);
+        if (::getsockname(fd_, addr.Data(), &size) < 0) {
+            return LastError();
+        }
+        return InetAddress::FromSockAddr(addr.Data(), size);
+    }
+
+    Result<InetAddress> PeerAddress() const {
+        InetAddress addr;
+        socklen_t size = sizeof(sockaddr_storage);
+        if (::getpeername(fd_, addr.Data(), &size) < 0) {
+            return LastError();
+        }
+        return InetAddress::FromSockAddr(addr.Data(), size);
+    }
+
+   protected:
+    Fd fd_ = -1;
+};
+
+// a non-blocking syscall which is retried whenever the socket is ready,
+// until it completes
+class SocketOperation {
+   public:
+    virtual ~SocketOperation() = default;
+
+    // performs the syscall, false if it would block
+    virtual bool Try() = 0;
+
+    // completes the operation without the syscall, e.g. the socket is closed
+    virtual void Fail(std::error_code ec) = 0;
+
+    std::coroutine_handle<> handle;
+};
+
+// an operation failed by SocketWatcher::Cancel. its coroutine may destroy
+// the socket, so it's resumed once the socket is closed
+class CancelledOperation {
+   public:
+    CancelledOperation() = default;
+    CancelledOperation(EventLoop* loop, std::coroutine_handle<> handle)
+        : loop_(loop), handle_(handle) {}
+
+    void Resume() {
+        if (handle_) {
+            ResumeCoroutine(loop_, std::exchange(handle_, {}));
+        }
+    }
+
+   private:
+    EventLoop* loop_ = nullptr;
+    std::coroutine_handle<> handle_;
+};
+
+// the readiness of one direction of a socket. the io event is persistent, so
+// a connection registers its fd once rather than per syscall. it's dropped
+// after a few wakeups in a row with nobody waiting, so an unread
+// level-triggered socket doesn't wake up the loop over and over, while a
+// coroutine which waits again a moment later keeps the registration
+class SocketWatcher {
+   public:
+    explicit SocketWatcher(IOEventType type) : type_(type) {}
+
+    // the io event refers to the watcher, so it's not moved along. it's
+    // registered again by the next wait
+    SocketWatcher(SocketWatcher&& other) noexcept
+        : type_(other.type_), loop_(nullptr), op_(nullptr) {
+        ASSERT(other.op_ == nullptr);
+        other.event_.reset();
+    }
+
+    SocketWatcher& operator=(SocketWatcher&& other) noexcept {
+        ASSERT(op_ == nullptr && other.op_ == nullptr);
+        event_.reset();
+        other.event_.reset();
+        type_ = other.type_;
+        return *this;
+    }
+
+    // suspends the operation until it completes, one operation at a time
+    void Wait(EventLoop* loop, Fd fd, SocketOperation* op) {
+        ASSERT(op_ == nullptr);
+        ASSERT(EventLoop::Current() == loop);
+
+        op_ = op;
+        idle_wakeups_ = 0;
+        if (!event_ || loop_ != loop) {
+            loop_ = loop;
+            event_ = loop->AddIOEvent(
+                fd, type_, MakeCallback([this]() { OnReady(); }),
+                IOEventMode::kPersistent);
+        }
+    }
+
+    // the operation is gone without completing, e.g. its coroutine is
+    // destroyed while suspended
+    void Abandon(SocketOperation* op) {
+        if (op_ == op) {
+            op_ = nullptr;
+        }
+    }
+
+    // unregisters the fd and fails the waiting operation, it's invoked
+    // before the fd is closed. the operation is resumed by the caller once
+    // the socket is closed
+    [[nodiscard]] CancelledOperation Cancel(std::error_code ec) {
+        event_.reset();
+
+        auto op = std::exchange(op_, nullptr);
+        if (!op) {
+            return {};
+        }
+
+        op->Fail(std::move(ec));
+        return CancelledOperation(loop_, std::exchange(op->handle, {}));
+    }
+
+    bool IsWaiting() const { return op_ != nullptr; }
+
+   private:
+    // the resumed coroutine may destroy the watcher, so it's resumed at last
+    void OnReady() {
+        if (!op_) {
+            if (++idle_wakeups_ >= kMaxIdleWakeups) {
+                event_.reset();
+            }
+            return;
+        }
+
+        if (!op_->Try()) {
+            return;
+        }
+
+        Complete(std::exchange(op_, nullptr));
+    }
+
+    // an operation without coroutine runs in the background, e.g. flushing
+    // the queued writes
+    void Complete(SocketOperation* op) {
+        if (op->handle) {
+            ResumeCoroutine(loop_, std::exchange(op->handle, {}));
+        }
+    }
+
+    static constexpr int kMaxIdleWakeups = 4;
+
+    IOEventType type_;
+    EventLoop* loop_ = nullptr;
+    SocketOperation* op_ = nullptr;
+    int idle_wakeups_ = 0;
+    std::unique_ptr<IOEvent> event_;
+};
+
+// the awaiter of a socket operation. the syscall is tried before suspending,
+// so a ready socket costs neither an io event nor a loop iteration
+template <typename T>
+class SocketAwaiter : public SocketOperation {
+   public:
+    SocketAwaiter(EventLoop* loop, Fd fd, SocketWatcher* watcher)
+        : loop_(loop), fd_(fd), watcher_(watcher) {}
+
+    ~SocketAwaiter() override { Abandon(); }
+
+    bool await_ready() { return Try(); }
+
+    void await_suspend(std::coroutine_handle<> h) {
+        handle = h;
+        watcher_->Wait(loop_, fd_, this);
+    }
+
+    Result<T> await_resume() { return std::move(res_); }
+
+    // the failed operation is detached from the watcher, which may be gone
+    // by the time the coroutine is resumed
+    void Fail(std::error_code ec) override {
+        res_ = Result<T>(std::move(ec));
+        watcher_ = nullptr;
+    }
+
+   protected:
+    void Abandon() {
+        if (watcher_) {
+            watcher_->Abandon(this);
+        }
+    }
+
+    // true if the errno means retrying later
+    static bool WouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK; }
+
+    EventLoop* loop_;
+    Fd fd_;
+    SocketWatcher* watcher_;
+    Result<T> res_;
+};
+
+}  // namespace evcpp
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <coroutine.h>
+
+#include <coroutine>
+#include <utility>
+
+namespace evcpp {
+
+template <typename T, typename E>
+class Task;
+
+namespace detail {
+
+// the common part of the task promise types, the awaiting coroutine is
+// resumed by symmetric transfer when the task completes
+template <typename T, typename E>
+class TaskPromiseBase : public FrameAllocated {
+   public:
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<P> handle) noexcept {
+            auto continuation = handle.promise().continuation_;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    // unhandle any exceptions
+    void unhandled_exception() {
+        std::rethrow_exception(std::current_exception());
+    }
+
+    void SetContinuation(std::coroutine_handle<> continuation) noexcept {
+        continuation_ = continuation;
+    }
+
+    Result<T, E>& GetResult() noexcept { return res_; }
+
+   protected:
+    std::coroutine_handle<> continuation_;
+    Result<T, E> res_;
+};
+
+}  // namespace detail
+
+// a lazy coroutine, it starts when it's awaited and stores the result in its
+// own frame. unlike a coroutine returning Promise, there is no shared state,
+// no resolver and no callback, so it's for the internal call graphs where
+// every coroutine is awaited exactly once. a task can be awaited once, and
+// ToPromise runs it as a Promise for the rest of the world
+template <typename T, typename E = std::error_code>
+class Task {
+   public:
+    class promise_type : public detail::TaskPromiseBase<T, E> {
+       public:
+        Task get_return_object() noexcept {
+            return Task(
+                std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_value(T&& val) noexcept {
+            this->res_ = Result<T, E>(std::forward<T>(val));
+        }
+
+        void return_value(E&& e) noexcept {
+            this->res_ = Result<T, E>(std::forward<E>(e));
+        }
+
+        template <typename _T, typename _E>
+        void return_value(Result<_T, _E>&& r) noexcept {
+            this->res_ = std::move(r);
+        }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class Awaiter {
+       public:
+        explicit Awaiter(Handle handle) : handle_(handle) {}
+
+        bool await_ready() const noexcept { return handle_.done(); }
+
+        // starts the task, it transfers back at the final suspend point
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<> awaiting) noexcept {
+            handle_.promise().SetContinuation(awaiting);
+            return handle_;
+        }
+
+        Result<T, E> await_resume() {
+            return std::move(handle_.promise().GetResult());
+        }
+
+       private:
+        Handle handle_;
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task&) = delete;
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            Destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { Destroy(); }
+
+    Awaiter operator co_await() && noexcept {
+        ASSERT(handle_);
+        return Awaiter(handle_);
+    }
+
+    // starts the task in the calling thread, the returned promise is settled
+    // with its result
+    Promise<T, E> ToPromise() && { return Run(std::move(*this)); }
+
+   private:
+    explicit Task(Handle handle) : handle_(handle) {}
+
+    static Promise<T, E> Run(Task task) {
+        co_return co_await std::move(task);
+    }
+
+    void Destroy() {
+        if (handle_) {
+            std::exchange(handle_, {}).destroy();
+        }
+    }
+
+    Handle handle_;
+};
+
+template <typename E>
+class Task<void, E> {
+   public:
+    // the return_void and return_value method cannot co-exist, same as
+    // Promise<void, E>, use Result<void, E> to complete the task
+    class promise_type : public detail::TaskPromiseBase<void, E> {
+       public:
+        Task get_return_object() noexcept {
+            return Task(
+                std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        void return_value(E&& e) noexcept {
+            this->res_ = Result<void, E>(std::forward<E>(e));
+        }
+
+        template <typename _E>
+        void return_value(Result<void, _E>&& r) noexcept {
+            this->res_ = std::move(r);
+        }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class Awaiter {
+       public:
+        explicit Awaiter(Handle handle) : handle_(handle) {}
+
+        bool await_ready() const noexcept { return handle_.done(); }
+
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<> awaiting) noexcept {
+            handle_.promise().SetContinuation(awaiting);
+            return handle_;
+        }
+
+        Result<void, E> await_resume() {
+            return std::move(handle_.promise().GetResult());
+        }
+
+       private:
+        Handle handle_;
+    };
+
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task(const Task&) = delete;
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            Destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { Destroy(); }
+
+    Awaiter operator co_await() && noexcept {
+        ASSERT(handle_);
+        return Awaiter(handle_);
+    }
+
+    Promise<void, E> ToPromise() && { return Run(std::move(*this)); }
+
+   private:
+    explicit Task(Handle handle) : handle_(handle) {}
+
+    static Promise<void, E> Run(Task task) {
+        auto r = co_await std::move(task);
+        if (r.IsError()) {
+            co_return std::move(r.Error());
+        }
+        co_return Result<void, E>();
+    }
+
+    void Destroy() {
+        if (handle_) {
+            std::exchange(handle_, {}).destroy();
+        }
+    }
+
+    Handle handle_;
+};
+
+}  // namespace evcpp
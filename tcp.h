@@ -0,0 +1,894 @@
+#pragma once
+
+#include <iobuf.h>
+#include <pipe.h>
+#include <socket.h>
+#include <task.h>
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <utility>
+
+namespace evcpp {
+
+// a connected tcp socket of one loop. the reads and the writes try the
+// syscall first and only wait on EAGAIN, and one read and one write may be
+// in flight at the same time
+class TcpStream : public Socket {
+   public:
+    class ReadAwaiter : public SocketAwaiter<std::size_t> {
+       public:
+        ReadAwaiter(TcpStream* stream, void* buf, std::size_t size)
+            : SocketAwaiter(stream->loop_, stream->fd_,
+                            &stream->read_watcher_),
+              buf_(buf),
+              size_(size) {}
+
+        bool Try() override {
+            while (true) {
+                auto n = ::read(fd_, buf_, size_);
+                if (n >= 0) {
+                    res_ = std::size_t(n);
+                    return true;
+                }
+
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                res_ = LastError();
+                return true;
+            }
+        }
+
+       private:
+        void* buf_;
+        std::size_t size_;
+    };
+
+    // completes when the whole buffer is written, the partial writes are
+    // continued at the next readiness
+    class WriteAwaiter : public SocketAwaiter<std::size_t> {
+       public:
+        WriteAwaiter(TcpStream* stream, const void* buf, std::size_t size)
+            : SocketAwaiter(stream->loop_, stream->fd_,
+                            &stream->write_watcher_),
+              buf_(static_cast<const char*>(buf)),
+              size_(size),
+              written_(0) {}
+
+        bool Try() override {
+            while (written_ < size_) {
+                // no SIGPIPE when the peer is gone, it's EPIPE instead
+                auto n = ::send(fd_, buf_ + written_, size_ - written_,
+                                MSG_NOSIGNAL);
+                if (n >= 0) {
+                    written_ += n;
+                    continue;
+                }
+
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                res_ = LastError();
+                return true;
+            }
+
+            res_ = std::size_t(written_);
+            return true;
+        }
+
+       private:
+        const char* buf_;
+        std::size_t size_;
+        std::size_t written_;
+    };
+
+    // reads into the free space at the tail of the buffer with readv, the
+    // buffer grows by blocks as needed. the blocks left empty are returned
+    // to the pool, so an idle connection waiting for data holds no block
+    class IOBufReadAwaiter : public SocketAwaiter<std::size_t> {
+       public:
+        IOBufReadAwaiter(TcpStream* stream, IOBuf* buf, std::size_t size)
+            : SocketAwaiter(stream->loop_, stream->fd_,
+                            &stream->read_watcher_),
+              buf_(buf),
+              size_(size) {}
+
+        bool Try() override {
+            buf_->Reserve(size_);
+
+            iovec iov[IOBuf::kMaxIovecs];
+            auto count = buf_->FillTailIovecs(iov, IOBuf::kMaxIovecs, size_);
+
+            while (true) {
+                auto n = ::readv(fd_, iov, count);
+                if (n >= 0) {
+                    buf_->Commit(n);
+                    buf_->ReleaseTail();
+                    res_ = std::size_t(n);
+                    return true;
+                }
+
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                buf_->ReleaseTail();
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                res_ = LastError();
+                return true;
+            }
+        }
+
+       private:
+        IOBuf* buf_;
+        std::size_t size_;
+    };
+
+    // writes the whole chain with writev, the awaiter owns the buffer until
+    // then
+    class IOBufWriteAwaiter : public SocketAwaiter<std::size_t> {
+       public:
+        IOBufWriteAwaiter(TcpStream* stream, IOBuf&& buf)
+            : SocketAwaiter(stream->loop_, stream->fd_,
+                            &stream->write_watcher_),
+              buf_(std::move(buf)),
+              written_(0) {}
+
+        bool Try() override {
+            std::error_code ec;
+            if (!SendIOBuf(fd_, &buf_, &written_, &ec)) {
+                return false;
+            }
+
+            if (ec) {
+                res_ = std::move(ec);
+            } else {
+                res_ = std::size_t(written_);
+            }
+            return true;
+        }
+
+       private:
+        IOBuf buf_;
+        std::size_t written_;
+    };
+
+    // sends count bytes of a file from the offset with sendfile, the bytes
+    // go from the page cache to the socket. it completes early at the end
+    // of the file
+    class SendFileAwaiter : public SocketAwaiter<std::size_t> {
+       public:
+        SendFileAwaiter(TcpStream* stream, Fd file, off_t offset,
+                        std::size_t count)
+            : SocketAwaiter(stream->loop_, stream->fd_,
+                            &stream->write_watcher_),
+              file_(file),
+              offset_(offset),
+              count_(count),
+              sent_(0) {}
+
+        bool Try() override {
+            while (sent_ < count_) {
+                auto n = ::sendfile(fd_, file_, &offset_, count_ - sent_);
+                if (n > 0) {
+                    sent_ += n;
+                    continue;
+                }
+                if (n == 0) {
+                    break;
+                }
+
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                res_ = LastError();
+                return true;
+            }
+
+            res_ = std::size_t(sent_);
+            return true;
+        }
+
+       private:
+        Fd file_;
+        off_t offset_;
+        std::size_t count_;
+        std::size_t sent_;
+    };
+
+    // moves at most size bytes from the socket into the pipe with splice,
+    // zero means the peer closed the connection. the pipe must have room,
+    // since a full pipe blocks the same way as an unreadable socket
+    class SpliceReadAwaiter : public SocketAwaiter<std::size_t> {
+       public:
+        SpliceReadAwaiter(TcpStream* stream, Pipe* pipe, std::size_t size)
+            : SocketAwaiter(stream->loop_, stream->fd_,
+                            &stream->read_watcher_),
+              pipe_(pipe),
+              size_(size) {}
+
+        bool Try() override {
+            while (true) {
+                auto n = ::splice(fd_, nullptr, pipe_->WriteFd(), nullptr,
+                                  size_, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n >= 0) {
+                    res_ = std::size_t(n);
+                    return true;
+                }
+
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                res_ = LastError();
+                return true;
+            }
+        }
+
+       private:
+        Pipe* pipe_;
+        std::size_t size_;
+    };
+
+    // moves size bytes from the pipe into the socket with splice, the pipe
+    // must hold them
+    class SpliceWriteAwaiter : public SocketAwaiter<std::size_t> {
+       public:
+        SpliceWriteAwaiter(TcpStream* stream, Pipe* pipe, std::size_t size)
+            : SocketAwaiter(stream->loop_, stream->fd_,
+                            &stream->write_watcher_),
+              pipe_(pipe),
+              size_(size),
+              written_(0) {}
+
+        bool Try() override {
+            while (written_ < size_) {
+                auto n = ::splice(pipe_->ReadFd(), nullptr, fd_, nullptr,
+                                  size_ - written_,
+                                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (n > 0) {
+                    written_ += n;
+                    continue;
+                }
+                if (n == 0) {
+                    res_ = std::make_error_code(std::errc::broken_pipe);
+                    return true;
+                }
+
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                res_ = LastError();
+                return true;
+            }
+
+            res_ = std::size_t(written_);
+            return true;
+        }
+
+       private:
+        Pipe* pipe_;
+        std::size_t size_;
+        std::size_t written_;
+    };
+
+    // completes when the queued writes are written, it's the number of
+    // bytes written meanwhile. the flush operation hands the result over,
+    // so the resumed coroutine doesn't touch the stream, which may be gone
+    // by then
+    class FlushAwaiter {
+       public:
+        explicit FlushAwaiter(TcpStream* stream)
+            : stream_(stream), start_(stream->flushed_) {}
+
+        // the coroutine is destroyed while suspended, the flush goes on in
+        // the background without resuming anybody
+        ~FlushAwaiter() {
+            if (stream_ && stream_->flush_op_.waiter_ == this) {
+                stream_->flush_op_.waiter_ = nullptr;
+                stream_->flush_op_.handle = {};
+            }
+        }
+
+        // the queue is written at once, rather than at the end of the
+        // iteration
+        bool await_ready() {
+            if (!stream_->write_error_ && !stream_->pending_.Empty()) {
+                if (stream_->flush_active_ || !stream_->SendPending()) {
+                    return false;
+                }
+            }
+
+            Complete();
+            return true;
+        }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            ASSERT(!stream_->flush_op_.handle);
+            stream_->flush_op_.waiter_ = this;
+            stream_->flush_op_.handle = h;
+            if (!stream_->flush_active_) {
+                stream_->StartFlush();
+            }
+        }
+
+        Result<std::size_t> await_resume() { return std::move(res_); }
+
+       private:
+        // takes the result from the stream, and detaches from it
+        void Complete() {
+            if (stream_->write_error_) {
+                res_ = std::error_code(stream_->write_error_);
+            } else {
+                res_ = std::size_t(stream_->flushed_ - start_);
+            }
+            stream_ = nullptr;
+        }
+
+        TcpStream* stream_;
+        std::size_t start_;
+        Result<std::size_t> res_;
+
+        friend class TcpStream;
+    };
+
+    // the stream is complete only after the class
+    class ConnectAwaiter;
+
+    TcpStream()
+        : loop_(nullptr),
+          read_watcher_(IOEventType::kRead),
+          write_watcher_(IOEventType::kWrite),
+          flush_op_(this),
+          flush_hook_(MakeCallback([this]() { OnFlushHook(); })),
+          flush_active_(false),
+          flushed_(0) {}
+
+    // adopts a connected socket, the fd must be non-blocking
+    TcpStream(EventLoop* loop, Fd fd) : TcpStream() {
+        fd_ = fd;
+        loop_ = loop;
+    }
+
+    TcpStream(TcpStream&& other) noexcept : TcpStream() { MoveFrom(other); }
+
+    TcpStream& operator=(TcpStream&& other) noexcept {
+        if (this != &other) {
+            Close();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    ~TcpStream() { Close(); }
+
+    [[nodiscard]] static ConnectAwaiter Connect(EventLoop* loop,
+                                                const InetAddress& addr);
+
+    // reads at most size bytes, zero means the peer closed the connection
+    [[nodiscard]] ReadAwaiter Read(void* buf, std::size_t size) {
+        return ReadAwaiter(this, buf, size);
+    }
+
+    // the direct writes bypass the queue, so the queue must be flushed first
+    [[nodiscard]] WriteAwaiter Write(const void* buf, std::size_t size) {
+        ASSERT(pending_.Empty() && !flush_active_);
+        return WriteAwaiter(this, buf, size);
+    }
+
+    // appends at most size bytes to the buffer, zero means the peer closed
+    // the connection
+    [[nodiscard]] IOBufReadAwaiter Read(IOBuf& buf,
+                                        std::size_t size = IOBuf::kBlockSize) {
+        return IOBufReadAwaiter(this, &buf, size);
+    }
+
+    [[nodiscard]] IOBufWriteAwaiter Write(IOBuf&& buf) {
+        ASSERT(pending_.Empty() && !flush_active_);
+        return IOBufWriteAwaiter(this, std::move(buf));
+    }
+
+    [[nodiscard]] SendFileAwaiter SendFile(Fd file, off_t offset,
+                                           std::size_t count) {
+        ASSERT(pending_.Empty() && !flush_active_);
+        return SendFileAwaiter(this, file, offset, count);
+    }
+
+    [[nodiscard]] SpliceReadAwaiter SpliceTo(Pipe& pipe, std::size_t size) {
+        return SpliceReadAwaiter(this, &pipe, size);
+    }
+
+    [[nodiscard]] SpliceWriteAwaiter SpliceFrom(Pipe& pipe,
+                                                std::size_t size) {
+        ASSERT(pending_.Empty() && !flush_active_);
+        return SpliceWriteAwaiter(this, &pipe, size);
+    }
+
+    // queues the buffer without writing it, the queue is written with one
+    // writev at the end of the loop iteration, so e.g. the responses of
+    // pipelined requests share a syscall. once a write of the queue fails,
+    // the queue is dropped and the error is reported by Flush
+    void Queue(IOBuf&& buf) {
+        ASSERT(!write_watcher_.IsWaiting() || flush_active_);
+        if (write_error_ || buf.Empty()) {
+            return;
+        }
+
+        pending_.Append(std::move(buf));
+        ScheduleFlush();
+    }
+
+    void Queue(const void* data, std::size_t size) {
+        ASSERT(!write_watcher_.IsWaiting() || flush_active_);
+        if (write_error_ || size == 0) {
+            return;
+        }
+
+        pending_.Append(data, size);
+        ScheduleFlush();
+    }
+
+    // writes the queue now, e.g. for a latency-critical send, and waits
+    // until it's written. one flush may wait at a time
+    [[nodiscard]] FlushAwaiter Flush() { return FlushAwaiter(this); }
+
+    std::size_t QueuedBytes() const { return pending_.Size(); }
+
+    std::error_code ShutdownWrite() {
+        if (::shutdown(fd_, SHUT_WR) < 0) {
+            return LastError();
+        }
+        return {};
+    }
+
+    // the waiting read and write fail with ECANCELED. the queue is written
+    // as far as the socket buffer takes it, await Flush before closing to
+    // make sure all of it is written
+    void Close() {
+        if (IsOpen() && !pending_.Empty() && !flush_active_) {
+            SendPending();
+        }
+        flush_hook_.Unlink();
+        pending_.Clear();
+
+        auto ec = std::make_error_code(std::errc::operation_canceled);
+        auto reader = read_watcher_.Cancel(ec);
+        auto writer = write_watcher_.Cancel(ec);
+        Socket::Close();
+
+        // the resumed coroutines may destroy the stream
+        reader.Resume();
+        writer.Resume();
+    }
+
+    EventLoop* GetLoop() const { return loop_; }
+
+   private:
+    // writes the queue in the background when the socket buffer is full
+    class FlushOperation : public SocketOperation {
+       public:
+        explicit FlushOperation(TcpStream* stream)
+            : stream_(stream), waiter_(nullptr) {}
+
+        bool Try() override {
+            if (!stream_->SendPending()) {
+                return false;
+            }
+
+            stream_->flush_active_ = false;
+            CompleteWaiter();
+            return true;
+        }
+
+        void Fail(std::error_code ec) override {
+            stream_->write_error_ = ec;
+            stream_->pending_.Clear();
+            stream_->flush_active_ = false;
+            CompleteWaiter();
+        }
+
+       private:
+        void CompleteWaiter() {
+            if (waiter_) {
+                std::exchange(waiter_, nullptr)->Complete();
+            }
+        }
+
+        TcpStream* stream_;
+        // the coroutine awaiting Flush, if any
+        FlushAwaiter* waiter_;
+
+        friend class FlushAwaiter;
+    };
+
+    // writes the chain with writev until it's empty, false if it would block
+    static bool SendIOBuf(Fd fd, IOBuf* buf, std::size_t* written,
+                          std::error_code* ec) {
+        while (!buf->Empty()) {
+            iovec iov[IOBuf::kMaxIovecs];
+
+            msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = buf->FillIovecs(iov, IOBuf::kMaxIovecs);
+
+            // no SIGPIPE when the peer is gone, it's EPIPE instead
+            auto n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+            if (n >= 0) {
+                buf->TrimFront(n);
+                *written += n;
+                continue;
+            }
+
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return false;
+            }
+
+            *ec = LastError();
+            return true;
+        }
+
+        return true;
+    }
+
+    // the watchers, the flush operation and the flush hook refer to their
+    // stream, so they're rebuilt rather than moved. a background flush is
+    // taken over by this stream, while a coroutine awaiting Flush refers to
+    // the other one, so such a stream can't be moved
+    void MoveFrom(TcpStream& other) {
+        ASSERT(!other.flush_op_.handle);
+
+        auto flushing = std::exchange(other.flush_active_, false);
+        if (flushing) {
+            other.write_watcher_.Abandon(&other.flush_op_);
+        }
+
+        Socket::operator=(std::move(other));
+        loop_ = other.loop_;
+        read_watcher_ = std::move(other.read_watcher_);
+        write_watcher_ = std::move(other.write_watcher_);
+
+        pending_ = std::move(other.pending_);
+        write_error_ = std::exchange(other.write_error_, {});
+        flushed_ = std::exchange(other.flushed_, 0);
+
+        if (other.flush_hook_.IsScheduled()) {
+            other.flush_hook_.Unlink();
+            loop_->ScheduleIterationHook(&flush_hook_);
+        }
+
+        if (flushing) {
+            StartFlush();
+        }
+    }
+
+    void ScheduleFlush() {
+        if (!flush_active_) {
+            loop_->ScheduleIterationHook(&flush_hook_);
+        }
+    }
+
+    void OnFlushHook() {
+        if (flush_active_ || pending_.Empty()) {
+            return;
+        }
+
+        if (!SendPending()) {
+            StartFlush();
+        }
+    }
+
+    void StartFlush() {
+        flush_active_ = true;
+        write_watcher_.Wait(loop_, fd_, &flush_op_);
+    }
+
+    // true when the queue is written, or dropped after an error
+    bool SendPending() {
+        std::size_t written = 0;
+        std::error_code ec;
+        auto done = SendIOBuf(fd_, &pending_, &written, &ec);
+
+        flushed_ += written;
+        if (ec) {
+            write_error_ = ec;
+            pending_.Clear();
+        }
+        return done;
+    }
+
+    EventLoop* loop_;
+    SocketWatcher read_watcher_;
+    SocketWatcher write_watcher_;
+
+    // the queued writes
+    FlushOperation flush_op_;
+    IterationHook flush_hook_;
+    IOBuf pending_;
+    bool flush_active_;
+    std::error_code write_error_;
+    std::size_t flushed_;
+};
+
+class TcpStream::ConnectAwaiter : public SocketAwaiter<TcpStream> {
+   public:
+    ConnectAwaiter(EventLoop* loop, const InetAddress& addr)
+        : SocketAwaiter(loop, -1, nullptr), addr_(addr), started_(false) {
+        auto sock = Socket::Create(addr.Family(), SOCK_STREAM);
+        if (!sock) {
+            res_ = std::move(sock.Error());
+            return;
+        }
+
+        stream_ = TcpStream(loop, sock.Value().Release());
+        fd_ = stream_.fd_;
+        watcher_ = &stream_.write_watcher_;
+    }
+
+    // before the stream, which would fail the operation being destroyed
+    ~ConnectAwaiter() override { Abandon(); }
+
+    // the connection is in progress until the socket is writable, then
+    // SO_ERROR tells the result
+    bool Try() override {
+        if (res_.IsError()) {
+            return true;
+        }
+
+        if (!started_) {
+            started_ = true;
+            if (::connect(fd_, addr_.Data(), addr_.Size()) == 0) {
+                return true;
+            }
+
+            if (errno == EINPROGRESS || errno == EINTR) {
+                return false;
+            }
+
+            res_ = LastError();
+            return true;
+        }
+
+        auto err = stream_.GetOption(SOL_SOCKET, SO_ERROR);
+        if (!err) {
+            res_ = std::move(err.Error());
+        } else if (err.Value() != 0) {
+            res_ = std::error_code(err.Value(), std::generic_category());
+        }
+        return true;
+    }
+
+    // the stream is handed over once the watcher is done with it
+    Result<TcpStream> await_resume() {
+        if (res_.IsError()) {
+            return std::move(res_);
+        }
+        return std::move(stream_);
+    }
+
+   private:
+    InetAddress addr_;
+    bool started_;
+    TcpStream stream_;
+};
+
+inline TcpStream::ConnectAwaiter TcpStream::Connect(EventLoop* loop,
+                                                    const InetAddress& addr) {
+    return ConnectAwaiter(loop, addr);
+}
+
+// forwards the bytes of one stream to the other through the pipe, until the
+// end of the stream or count bytes, so a proxy moves them without a copy to
+// the user memory. it's the number of bytes forwarded, on an error the
+// bytes not yet written are left in the pipe
+inline Task<std::size_t> Splice(
+    TcpStream& from, TcpStream& to, Pipe& pipe,
+    std::size_t count = std::numeric_limits<std::size_t>::max()) {
+    auto capacity = pipe.Capacity();
+    auto chunk = capacity ? capacity.Value() : std::size_t(64 * 1024);
+
+    std::size_t forwarded = 0;
+    while (forwarded < count) {
+        auto r = co_await from.SpliceTo(pipe,
+                                        std::min(chunk, count - forwarded));
+        if (r.IsError()) {
+            co_return std::move(r.Error());
+        }
+        if (r.Value() == 0) {
+            break;
+        }
+
+        auto w = co_await to.SpliceFrom(pipe, r.Value());
+        if (w.IsError()) {
+            co_return std::move(w.Error());
+        }
+        forwarded += r.Value();
+    }
+
+    co_return std::size_t(forwarded);
+}
+
+// forwards the bytes of one stream to two others like Splice, e.g. to
+// replicate the traffic. the bytes in the pipe are duplicated into the copy
+// pipe with tee, so neither stream reaches the user memory. it's the number
+// of bytes forwarded to both
+inline Task<std::size_t> Mirror(
+    TcpStream& from, TcpStream& to, TcpStream& copy, Pipe& pipe,
+    Pipe& copy_pipe,
+    std::size_t count = std::numeric_limits<std::size_t>::max()) {
+    auto capacity = pipe.Capacity();
+    auto chunk = capacity ? capacity.Value() : std::size_t(64 * 1024);
+
+    std::size_t forwarded = 0;
+    while (forwarded < count) {
+        auto r = co_await from.SpliceTo(pipe,
+                                        std::min(chunk, count - forwarded));
+        if (r.IsError()) {
+            co_return std::move(r.Error());
+        }
+        if (r.Value() == 0) {
+            break;
+        }
+
+        // tee duplicates from the front of the pipe, so every part is
+        // consumed before the next one is duplicated
+        for (auto left = r.Value(); left > 0;) {
+            auto t = co_await pipe.Tee(from.GetLoop(), copy_pipe, left);
+            if (t.IsError()) {
+                co_return std::move(t.Error());
+            }
+
+            auto c = co_await copy.SpliceFrom(copy_pipe, t.Value());
+            if (c.IsError()) {
+                co_return std::move(c.Error());
+            }
+            auto w = co_await to.SpliceFrom(pipe, t.Value());
+            if (w.IsError()) {
+                co_return std::move(w.Error());
+            }
+            left -= t.Value();
+        }
+
+        forwarded += r.Value();
+    }
+
+    co_return std::size_t(forwarded);
+}
+
+struct TcpListenerOptions {
+    int backlog = SOMAXCONN;
+    bool reuse_addr = true;
+
+    // several listeners of the same port, the kernel spreads the
+    // connections over them
+    bool reuse_port = false;
+};
+
+// a listening tcp socket of one loop, the accepted streams belong to the
+// same loop
+class TcpListener : public Socket {
+   public:
+    class AcceptAwaiter : public SocketAwaiter<TcpStream> {
+       public:
+        explicit AcceptAwaiter(TcpListener* listener)
+            : SocketAwaiter(listener->loop_, listener->fd_,
+                            &listener->watcher_) {}
+
+        bool Try() override {
+            while (true) {
+                auto fd = ::accept4(fd_, nullptr, nullptr,
+                                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd >= 0) {
+                    res_ = TcpStream(loop_, fd);
+                    return true;
+                }
+
+                // the connection aborted before being accepted doesn't
+                // concern the listener
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                res_ = LastError();
+                return true;
+            }
+        }
+    };
+
+    TcpListener() : loop_(nullptr), watcher_(IOEventType::kRead) {}
+
+    TcpListener(TcpListener&&) = default;
+    TcpListener& operator=(TcpListener&& other) noexcept {
+        if (this != &other) {
+            Close();
+            Socket::operator=(std::move(other));
+            loop_ = other.loop_;
+            watcher_ = std::move(other.watcher_);
+        }
+        return *this;
+    }
+
+    ~TcpListener() { Close(); }
+
+    static Result<TcpListener> Listen(EventLoop* loop, const InetAddress& addr,
+                                      const TcpListenerOptions& options = {}) {
+        auto sock = Socket::Create(addr.Family(), SOCK_STREAM);
+        if (!sock) {
+            return std::move(sock.Error());
+        }
+
+        TcpListener listener(loop, sock.Value().Release());
+        if (options.reuse_addr) {
+            if (auto ec = listener.SetReuseAddr(true); ec) {
+                return std::move(ec);
+            }
+        }
+        if (options.reuse_port) {
+            if (auto ec = listener.SetReusePort(true); ec) {
+                return std::move(ec);
+            }
+        }
+
+        if (::bind(listener.fd_, addr.Data(), addr.Size()) < 0 ||
+            ::listen(listener.fd_, options.backlog) < 0) {
+            return LastError();
+        }
+
+        return std::move(listener);
+    }
+
+    [[nodiscard]] AcceptAwaiter Accept() { return AcceptAwaiter(this); }
+
+    // the waiting accept fails with ECANCELED
+    void Close() {
+        auto acceptor = watcher_.Cancel(
+            std::make_error_code(std::errc::operation_canceled));
+        Socket::Close();
+        acceptor.Resume();
+    }
+
+    EventLoop* GetLoop() const { return loop_; }
+
+   private:
+    TcpListener(EventLoop* loop, Fd fd)
+        : Socket(fd), loop_(loop), watcher_(IOEventType::kRead) {}
+
+    EventLoop* loop_;
+    SocketWatcher watcher_;
+};
+
+}  // namespace evcpp
@@ -0,0 +1,386 @@
+#pragma once
+
+#include <double_link.h>
+#include <event_loop.h>
+#include <slab_pool.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+namespace evcpp {
+
+struct WheelTimer : public DoubleLinkObject<WheelTimer> {
+    // the absolute expiration, in ticks
+    std::uint64_t expire = 0;
+
+    // false once the timer is moved out of the wheel
+    bool active = false;
+};
+
+// hierarchical timing wheel with O(1) insertion and removal. a timer is put in
+// the lowest level where its expiration shares the higher bits with the
+// current tick, and cascades down when the current tick reaches its slot. the
+// wheel knows nothing about time, the owner drives it with Advance
+class TimingWheel {
+   public:
+    static constexpr int kLevelBits = 6;
+    static constexpr int kSlots = 1 << kLevelBits;
+    static constexpr int kLevels = 5;
+
+    static constexpr std::uint64_t kSlotMask = kSlots - 1;
+    static constexpr std::uint64_t kMaxSpan = std::uint64_t(1)
+                                              << (kLevelBits * kLevels);
+
+    explicit TimingWheel(std::uint64_t now = 0) : current_(now), size_(0) {}
+
+    TimingWheel(const TimingWheel&) = delete;
+    TimingWheel& operator=(const TimingWheel&) = delete;
+
+   public:
+    void Add(WheelTimer* timer, std::uint64_t expire) {
+        timer->expire = expire;
+        timer->active = true;
+        Place(timer);
+        ++size_;
+    }
+
+    // it also unlinks the timer from the expired list of Advance
+    void Remove(WheelTimer* timer) {
+        timer->Unlink();
+
+        if (timer->active) {
+            timer->active = false;
+            --size_;
+        }
+    }
+
+    // processes all the ticks up to now, the expired timers are moved to the
+    // list of expired, which is owned by the caller. the empty slots are
+    // skipped, so a long idle period costs little
+    void Advance(std::uint64_t now, WheelTimer* expired) {
+        while (current_ <= now) {
+            if (size_ == 0) {
+                Jump(now + 1);
+                break;
+            }
+
+            auto& slot = slots_[0][current_ & kSlotMask];
+            while (slot.next != &slot) {
+                auto timer = slot.next;
+                timer->Unlink();
+                timer->Link(expired);
+                timer->active = false;
+                --size_;
+            }
+
+            ++current_;
+            if ((current_ & kSlotMask) == 0) {
+                Cascade();
+            }
+
+            if (auto next = NextExpiry(); next && *next > 0) {
+                Jump(std::min(current_ + *next, now + 1));
+            }
+        }
+    }
+
+    // the ticks until the next non-empty slot, it's exact for the lowest
+    // level and a lower bound for the others, which cascade first
+    std::optional<std::uint64_t> NextExpiry() const {
+        if (size_ == 0) {
+            return std::nullopt;
+        }
+
+        for (int level = 0; level < kLevels; ++level) {
+            auto shift = kLevelBits * level;
+            auto idx = (current_ >> shift) & kSlotMask;
+
+            // the current slot of the higher levels is already cascaded
+            for (auto i = level == 0 ? idx : idx + 1; i < kSlots; ++i) {
+                auto& slot = slots_[level][i];
+                if (slot.next == &slot) {
+                    continue;
+                }
+
+                auto base = (current_ >> (shift + kLevelBits))
+                            << (shift + kLevelBits);
+                auto start = base | (i << shift);
+                return start > current_ ? start - current_ : 0;
+            }
+        }
+
+        // only the far timers parked in the current top level slot are left
+        return kSlots - (current_ & kSlotMask);
+    }
+
+    template <typename F>
+    void ForEach(F&& f) {
+        for (auto& level : slots_) {
+            for (auto& slot : level) {
+                auto node = slot.next;
+                while (node != &slot) {
+                    auto next_node = node->next;
+                    f(node);
+                    node = next_node;
+                }
+            }
+        }
+    }
+
+    std::uint64_t Current() const { return current_; }
+    std::size_t Size() const { return size_; }
+
+   private:
+    // the slots between current_ and tick must be empty
+    void Jump(std::uint64_t tick) {
+        current_ = tick;
+        if ((current_ & kSlotMask) == 0) {
+            Cascade();
+        }
+    }
+
+    void Place(WheelTimer* timer) {
+        auto expire = timer->expire;
+        if (expire < current_) {
+            expire = current_;
+        }
+
+        // the far timers park in the top level, and are re-placed when
+        // they cascade
+        if (expire - current_ >= kMaxSpan) {
+            expire = current_ + kMaxSpan - 1;
+        }
+
+        int level = 0;
+        while (level < kLevels - 1 &&
+               (expire >> (kLevelBits * (level + 1))) !=
+                   (current_ >> (kLevelBits * (level + 1)))) {
+            ++level;
+        }
+
+        auto idx = (expire >> (kLevelBits * level)) & kSlotMask;
+        timer->Link(&slots_[level][idx]);
+    }
+
+    // when the lowest level wraps, the slots of the higher levels that
+    // current_ enters are re-placed, from the highest one to the lowest one.
+    // so the slots of current_ in the higher levels are always empty
+    void Cascade() {
+        int top = 1;
+        while (top < kLevels - 1 &&
+               ((current_ >> (kLevelBits * top)) & kSlotMask) == 0) {
+            ++top;
+        }
+
+        for (int level = top; level >= 1; --level) {
+            auto& slot =
+                slots_[level][(current_ >> (kLevelBits * level)) & kSlotMask];
+
+            WheelTimer pending;
+            while (slot.next != &slot) {
+                auto timer = slot.next;
+                timer->Unlink();
+                timer->Link(&pending);
+            }
+
+            while (pending.next != &pending) {
+                auto timer = pending.next;
+                timer->Unlink();
+                Place(timer);
+            }
+        }
+    }
+
+    std::array<std::array<WheelTimer, kSlots>, kLevels> slots_;
+
+    std::uint64_t current_;
+    std::size_t size_;
+};
+
+class WheelTimerService;
+
+// the timer is linked in the timing wheel of the loop instead of owning a
+// backend timer, so the insertion and the cancellation are O(1)
+class TimerEventWheelImpl : public WheelTimer,
+                            public TimerEvent,
+                            public PoolAllocated {
+   public:
+    TimerEventWheelImpl(WheelTimerService* service,
+                        UniqueFunction<void()>&& cb,
+                        std::chrono::milliseconds after, bool repeat,
+                        std::chrono::milliseconds slack)
+        : cb_(std::move(cb)),
+          after_(after),
+          slack_(slack),
+          repeat_(repeat),
+          cancelled_(false),
+          fired_(false),
+          service_(service) {}
+
+    TimerEventWheelImpl(const TimerEventWheelImpl&) = delete;
+    TimerEventWheelImpl& operator=(const TimerEventWheelImpl&) = delete;
+
+   public:
+    void Cancel() override;
+
+    bool Fired() const override { return fired_; }
+    bool Cancelled() const override { return cancelled_; }
+
+    ~TimerEventWheelImpl() override { Cancel(); }
+
+   private:
+    // the expiration is rounded up to a multiple of the slack, so the timers
+    // of the same window share one slot of the wheel
+    std::uint64_t Align(std::uint64_t expire) const {
+        auto slack = static_cast<std::uint64_t>(slack_.count());
+        return slack > 1 ? (expire + slack - 1) / slack * slack : expire;
+    }
+
+    UniqueFunction<void()> cb_;
+    std::chrono::milliseconds after_;
+    std::chrono::milliseconds slack_;
+
+    bool repeat_;
+    bool cancelled_;
+    bool fired_;
+
+    WheelTimerService* service_;
+
+    friend class WheelTimerService;
+};
+
+// the timers of one loop, kept in a timing wheel with millisecond ticks. the
+// loop blocks at most until NextExpiry, and calls Expire after it wakes up
+class WheelTimerService {
+   public:
+    // invoked with the expiration of every new timer, so that the loop can
+    // wake up earlier than planned
+    using AddHook = std::function<void(std::uint64_t)>;
+
+    explicit WheelTimerService(AddHook hook = nullptr)
+        : wheel_(NowTick()),
+          hook_(std::move(hook)),
+          pool_(SlabPool::Create(sizeof(TimerEventWheelImpl))) {}
+
+    WheelTimerService(const WheelTimerService&) = delete;
+    WheelTimerService& operator=(const WheelTimerService&) = delete;
+
+   public:
+    std::unique_ptr<TimerEvent> Add(std::chrono::milliseconds after,
+                                    std::chrono::milliseconds slack,
+                                    bool repeat, UniqueFunction<void()>&& cb) {
+        auto timer = new (pool_.get())
+            TimerEventWheelImpl(this, std::move(cb), after, repeat, slack);
+
+        // the timer never fires early, so the partial tick rounds up
+        Add(timer, timer->Align(NowTick() + after.count() + 1));
+
+        return std::unique_ptr<TimerEvent>(timer);
+    }
+
+    // runs the callbacks of the expired timers
+    void Expire() {
+        auto now = NowTick();
+
+        WheelTimer expired;
+        wheel_.Advance(now, &expired);
+
+        // the callback may cancel the other expired timers
+        while (expired.next != &expired) {
+            auto timer = static_cast<TimerEventWheelImpl*>(expired.next);
+            timer->Unlink();
+            timer->fired_ = true;
+
+            // a repeating timer behind by more than a period, e.g. after a
+            // stall, restarts from now rather than firing on every tick until
+            // it catches up, as libev does. a fired one-shot timer is
+            // detached, so its handle may outlive the service
+            if (timer->repeat_) {
+                auto next = timer->Align(timer->expire + timer->after_.count());
+                if (next <= now) {
+                    next = timer->Align(now + timer->after_.count());
+                }
+                wheel_.Add(timer, next);
+            } else {
+                timer->service_ = nullptr;
+            }
+
+            timer->cb_();
+        }
+    }
+
+    // the absolute tick of the next expiration, it may be earlier than the
+    // real one when the timer still needs to cascade
+    std::optional<std::uint64_t> NextExpiry() const {
+        auto next = wheel_.NextExpiry();
+        if (!next) {
+            return std::nullopt;
+        }
+
+        return wheel_.Current() + *next;
+    }
+
+    // how long the loop can block, e.g. the timeout of epoll_wait
+    std::optional<std::chrono::milliseconds> NextTimeout() const {
+        auto next = NextExpiry();
+        if (!next) {
+            return std::nullopt;
+        }
+
+        auto now = NowTick();
+        return std::chrono::milliseconds(*next > now ? *next - now : 0);
+    }
+
+    void CancelAll() {
+        wheel_.ForEach([](WheelTimer* timer) {
+            static_cast<TimerEventWheelImpl*>(timer)->Cancel();
+        });
+    }
+
+    std::size_t Size() const { return wheel_.Size(); }
+
+    const PoolStats& GetPoolStats() const { return pool_->GetStats(); }
+
+    static std::uint64_t NowTick() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(now)
+            .count();
+    }
+
+   private:
+    void Add(TimerEventWheelImpl* timer, std::uint64_t expire) {
+        wheel_.Add(timer, expire);
+
+        if (hook_) {
+            hook_(expire);
+        }
+    }
+
+    TimingWheel wheel_;
+    AddHook hook_;
+
+    SlabPool::Ptr pool_;
+
+    friend class TimerEventWheelImpl;
+};
+
+void TimerEventWheelImpl::Cancel() {
+    if (cancelled_) {
+        return;
+    }
+
+    if (!service_) {
+        cancelled_ = true;
+        return;
+    }
+
+    service_->wheel_.Remove(this);
+    cancelled_ = true;
+}
+
+}  // namespace evcpp
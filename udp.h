@@ -0,0 +1,422 @@
+#pragma once
+
+#include <socket.h>
+
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace evcpp {
+
+// a received datagram refers to the ring of its socket and stays valid until
+// the next receive. a datagram to send refers to the caller's bytes, and an
+// empty peer means the address the socket is connected to
+struct Datagram {
+    const char* data = nullptr;
+    std::size_t size = 0;
+    InetAddress peer;
+
+    // the bytes are a train of datagrams of this size, the last one may be
+    // shorter. a send is split by the kernel or the nic (UDP_SEGMENT), and
+    // a receive with gro gets the datagrams of one flow coalesced. zero is
+    // a single datagram
+    std::size_t segment_size = 0;
+
+    // the datagram was larger than the slot and was cut
+    bool truncated = false;
+
+    std::size_t Segments() const {
+        if (segment_size == 0) {
+            return 1;
+        }
+        return (size + segment_size - 1) / segment_size;
+    }
+
+    // invokes f(data, size) for every datagram of the train
+    template <typename F>
+    void ForEachSegment(F&& f) const {
+        auto step = segment_size == 0 ? size : segment_size;
+        for (std::size_t offset = 0; offset < size; offset += step) {
+            f(data + offset, std::min(step, size - offset));
+        }
+    }
+};
+
+struct UdpSocketOptions {
+    // the datagrams per recvmmsg or sendmmsg, at least one
+    std::size_t batch = 64;
+
+    // the bytes of one slot of the receive ring, the longer datagrams are
+    // truncated. with gro a slot takes a whole train, up to 64k
+    std::size_t max_datagram = 2048;
+
+    // receives the coalesced trains of UDP_GRO. every slot of the ring then
+    // takes 64k, so the default batch costs 4 MiB per socket, while a few
+    // slots usually suffice since a train carries dozens of datagrams
+    bool gro = false;
+
+    bool reuse_addr = false;
+    bool reuse_port = false;
+
+    // SO_RCVBUF, zero keeps the system default
+    int receive_buffer = 0;
+};
+
+// the space of one UDP_SEGMENT or UDP_GRO control message, the segment size
+// of gro is an int, and the one of UDP_SEGMENT is a u16
+constexpr std::size_t kSegmentControlSize = CMSG_SPACE(sizeof(int));
+
+// the largest train of UDP_SEGMENT or UDP_GRO
+constexpr std::size_t kMaxSegmentedSize = 65535;
+
+// the receive ring, every slot of the batch has its buffer, iovec, header,
+// address and control message, all allocated once. recvmmsg fills the
+// slots in place
+class DatagramRing {
+   public:
+    // the control message of one slot
+    struct Control {
+        alignas(cmsghdr) char data[kSegmentControlSize];
+    };
+
+    DatagramRing() = default;
+
+    DatagramRing(std::size_t batch, std::size_t max_datagram)
+        : max_datagram_(max_datagram),
+          buffer_(batch * max_datagram),
+          iovs_(batch),
+          msgs_(batch),
+          addrs_(batch),
+          controls_(batch),
+          datagrams_(batch) {}
+
+    std::size_t Batch() const { return msgs_.size(); }
+
+    // the headers are rewritten before every call, since the kernel
+    // overwrites the lengths
+    mmsghdr* Prepare() {
+        for (std::size_t i = 0; i < msgs_.size(); ++i) {
+            iovs_[i].iov_base = buffer_.data() + i * max_datagram_;
+            iovs_[i].iov_len = max_datagram_;
+
+            auto& hdr = msgs_[i].msg_hdr;
+            hdr = {};
+            hdr.msg_name = &addrs_[i];
+            hdr.msg_namelen = sizeof(sockaddr_storage);
+            hdr.msg_iov = &iovs_[i];
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = &controls_[i];
+            hdr.msg_controllen = sizeof(Control);
+            msgs_[i].msg_len = 0;
+        }
+        return msgs_.data();
+    }
+
+    // the datagrams of the first n slots
+    std::span<const Datagram> Complete(std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            auto& hdr = msgs_[i].msg_hdr;
+            auto& datagram = datagrams_[i];
+            datagram.data = static_cast<const char*>(iovs_[i].iov_base);
+            datagram.size = msgs_[i].msg_len;
+            datagram.peer = InetAddress::FromSockAddr(
+                reinterpret_cast<const sockaddr*>(&addrs_[i]),
+                hdr.msg_namelen);
+            datagram.segment_size = SegmentSize(&hdr);
+            datagram.truncated = hdr.msg_flags & MSG_TRUNC;
+        }
+        return {datagrams_.data(), n};
+    }
+
+   private:
+    static std::size_t SegmentSize(msghdr* hdr) {
+        for (auto cmsg = CMSG_FIRSTHDR(hdr); cmsg;
+             cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int size = 0;
+                std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+                return size;
+            }
+        }
+        return 0;
+    }
+
+    std::size_t max_datagram_ = 0;
+    std::vector<char> buffer_;
+    std::vector<iovec> iovs_;
+    std::vector<mmsghdr> msgs_;
+    std::vector<sockaddr_storage> addrs_;
+    std::vector<Control> controls_;
+    std::vector<Datagram> datagrams_;
+};
+
+// a udp socket of one loop, the datagrams are received and sent in batches
+// with one recvmmsg or sendmmsg per batch. one receive and one send may be
+// in flight at the same time
+class UdpSocket : public Socket {
+   public:
+    // completes with the datagrams of one recvmmsg, as many as were queued
+    // up to the batch
+    class ReceiveAwaiter : public SocketAwaiter<std::span<const Datagram>> {
+       public:
+        explicit ReceiveAwaiter(UdpSocket* socket)
+            : SocketAwaiter(socket->loop_, socket->fd_,
+                            &socket->read_watcher_),
+              ring_(&socket->ring_) {}
+
+        bool Try() override {
+            while (true) {
+                auto msgs = ring_->Prepare();
+                auto n = ::recvmmsg(fd_, msgs, ring_->Batch(), MSG_DONTWAIT,
+                                    nullptr);
+                if (n >= 0) {
+                    res_ = ring_->Complete(n);
+                    return true;
+                }
+
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                res_ = LastError();
+                return true;
+            }
+        }
+
+       private:
+        DatagramRing* ring_;
+    };
+
+    // completes when all the datagrams are sent, a batch per sendmmsg. it's
+    // the number of datagrams sent. like a partial write, a send failing
+    // after some datagrams went out completes with their number, and the
+    // error is reported by the next send
+    class SendAwaiter : public SocketAwaiter<std::size_t> {
+       public:
+        SendAwaiter(UdpSocket* socket, std::span<const Datagram> datagrams)
+            : SocketAwaiter(socket->loop_, socket->fd_,
+                            &socket->write_watcher_),
+              socket_(socket),
+              datagrams_(datagrams),
+              sent_(0) {}
+
+        bool Try() override {
+            if (sent_ == 0 && socket_->send_error_) {
+                res_ = std::exchange(socket_->send_error_, {});
+                return true;
+            }
+
+            while (sent_ < datagrams_.size()) {
+                auto count = socket_->PrepareSend(datagrams_.subspan(sent_));
+                auto n = ::sendmmsg(fd_, socket_->send_msgs_.data(), count,
+                                    MSG_DONTWAIT);
+                if (n >= 0) {
+                    sent_ += n;
+                    continue;
+                }
+
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (WouldBlock()) {
+                    return false;
+                }
+
+                if (sent_ == 0) {
+                    res_ = LastError();
+                    return true;
+                }
+
+                socket_->send_error_ = LastError();
+                break;
+            }
+
+            res_ = std::size_t(sent_);
+            return true;
+        }
+
+       private:
+        UdpSocket* socket_;
+        std::span<const Datagram> datagrams_;
+        std::size_t sent_;
+    };
+
+    UdpSocket()
+        : loop_(nullptr),
+          read_watcher_(IOEventType::kRead),
+          write_watcher_(IOEventType::kWrite) {}
+
+    UdpSocket(UdpSocket&& other) noexcept = default;
+    UdpSocket& operator=(UdpSocket&& other) noexcept {
+        if (this != &other) {
+            Close();
+            Socket::operator=(std::move(other));
+            loop_ = other.loop_;
+            read_watcher_ = std::move(other.read_watcher_);
+            write_watcher_ = std::move(other.write_watcher_);
+            ring_ = std::move(other.ring_);
+            send_iovs_ = std::move(other.send_iovs_);
+            send_msgs_ = std::move(other.send_msgs_);
+            send_controls_ = std::move(other.send_controls_);
+            send_error_ = std::exchange(other.send_error_, {});
+        }
+        return *this;
+    }
+
+    ~UdpSocket() { Close(); }
+
+    // an unbound socket of the family, e.g. a client which only sends
+    static Result<UdpSocket> Open(EventLoop* loop, int family,
+                                  const UdpSocketOptions& options = {}) {
+        if (options.batch == 0) {
+            return std::make_error_code(std::errc::invalid_argument);
+        }
+
+        auto s = Socket::Create(family, SOCK_DGRAM, IPPROTO_UDP);
+        if (!s) {
+            return std::move(s.Error());
+        }
+
+        UdpSocket socket(loop, s.Value().Release(), options);
+        if (options.gro) {
+            if (auto ec = socket.SetOption(SOL_UDP, UDP_GRO, 1); ec) {
+                return ec;
+            }
+        }
+        if (options.receive_buffer > 0) {
+            if (auto ec = socket.SetReceiveBufferSize(options.receive_buffer);
+                ec) {
+                return ec;
+            }
+        }
+        return std::move(socket);
+    }
+
+    static Result<UdpSocket> Bind(EventLoop* loop, const InetAddress& addr,
+                                  const UdpSocketOptions& options = {}) {
+        auto r = Open(loop, addr.Family(), options);
+        if (!r) {
+            return std::move(r.Error());
+        }
+
+        auto socket = std::move(r.Value());
+        if (options.reuse_addr) {
+            if (auto ec = socket.SetReuseAddr(true); ec) {
+                return ec;
+            }
+        }
+        if (options.reuse_port) {
+            if (auto ec = socket.SetReusePort(true); ec) {
+                return ec;
+            }
+        }
+
+        if (::bind(socket.fd_, addr.Data(), addr.Size()) < 0) {
+            return LastError();
+        }
+        return std::move(socket);
+    }
+
+    // sets the default peer, the datagrams of other addresses are dropped
+    std::error_code Connect(const InetAddress& addr) {
+        if (::connect(fd_, addr.Data(), addr.Size()) < 0) {
+            return LastError();
+        }
+        return {};
+    }
+
+    [[nodiscard]] ReceiveAwaiter Receive() { return ReceiveAwaiter(this); }
+
+    // the datagrams must stay alive until the send completes. a datagram
+    // with a segment size is a train of up to 64k, and the kernel limits
+    // the segments per train, 64 on older kernels
+    [[nodiscard]] SendAwaiter Send(std::span<const Datagram> datagrams) {
+        return SendAwaiter(this, datagrams);
+    }
+
+    // the waiting receive and send fail with ECANCELED
+    void Close() {
+        auto ec = std::make_error_code(std::errc::operation_canceled);
+        auto receiver = read_watcher_.Cancel(ec);
+        auto sender = write_watcher_.Cancel(ec);
+        Socket::Close();
+
+        // the resumed coroutines may destroy the socket
+        receiver.Resume();
+        sender.Resume();
+    }
+
+    EventLoop* GetLoop() const { return loop_; }
+
+   private:
+    UdpSocket(EventLoop* loop, Fd fd, const UdpSocketOptions& options)
+        : Socket(fd),
+          loop_(loop),
+          read_watcher_(IOEventType::kRead),
+          write_watcher_(IOEventType::kWrite),
+          ring_(options.batch,
+                options.gro ? std::max(options.max_datagram, kMaxSegmentedSize)
+                            : options.max_datagram),
+          send_iovs_(options.batch),
+          send_msgs_(options.batch),
+          send_controls_(options.batch) {}
+
+    // fills the send headers with a batch of the datagrams, it's the number
+    // of headers filled
+    std::size_t PrepareSend(std::span<const Datagram> datagrams) {
+        auto count = std::min(datagrams.size(), send_msgs_.size());
+        for (std::size_t i = 0; i < count; ++i) {
+            auto& datagram = datagrams[i];
+            send_iovs_[i].iov_base = const_cast<char*>(datagram.data);
+            send_iovs_[i].iov_len = datagram.size;
+
+            auto& hdr = send_msgs_[i].msg_hdr;
+            hdr = {};
+            if (datagram.peer.Size() > 0) {
+                hdr.msg_name = const_cast<sockaddr*>(datagram.peer.Data());
+                hdr.msg_namelen = datagram.peer.Size();
+            }
+            hdr.msg_iov = &send_iovs_[i];
+            hdr.msg_iovlen = 1;
+
+            if (datagram.segment_size > 0) {
+                hdr.msg_control = &send_controls_[i];
+                hdr.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+
+                auto cmsg = CMSG_FIRSTHDR(&hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+
+                std::uint16_t size = datagram.segment_size;
+                std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+            }
+        }
+        return count;
+    }
+
+    EventLoop* loop_;
+    SocketWatcher read_watcher_;
+    SocketWatcher write_watcher_;
+
+    DatagramRing ring_;
+    std::vector<iovec> send_iovs_;
+    std::vector<mmsghdr> send_msgs_;
+    std::vector<DatagramRing::Control> send_controls_;
+
+    // the error of a send which failed after a part of its datagrams
+    std::error_code send_error_;
+};
+
+}  // namespace evcpp